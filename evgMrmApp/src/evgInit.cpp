@@ -592,10 +592,12 @@ mrmEvgSetupPCI (
             // By default the IRQPollers for EVRU/D are disabled.
             // __IRQP_EVRU/D_PRD selects the polling perdiod [s] and enables the equivalent EVM embedded EVR.
 #ifdef __IRQP_EVRU_PRD
-            new IRQPoller(&EVRMRM::isr_poll, static_cast<void *>(evg->getEvruMrm()), __IRQP_EVRU_PRD);
+            new IRQPoller(&EVRMRM::isr_poll, static_cast<void *>(evg->getEvruMrm()), __IRQP_EVRU_PRD,
+                          &evg->getEvruMrm()->isrPollSched());
 #endif
 #ifdef __IRQP_EVRD_PRD
-            new IRQPoller(&EVRMRM::isr_poll, static_cast<void *>(evg->getEvrdMrm()), __IRQP_EVRD_PRD);
+            new IRQPoller(&EVRMRM::isr_poll, static_cast<void *>(evg->getEvrdMrm()), __IRQP_EVRD_PRD,
+                          &evg->getEvrdMrm()->isrPollSched());
 #endif
             printf("PCI interrupt connected!\n");
         }
@@ -95,7 +95,7 @@ evgMrm::evgMrm(const std::string& id,
                volatile epicsUInt8* const pReg,
                const epicsPCIDevice *pciDevice):
     mrf::ObjectInst<evgMrm>(id),
-    TimeStampSource(1.0),
+    TimeStampSource(1.0, id),
     MRMSPI(pReg+U32_SPIDData),
     irqExtInp_queued(0),
     m_buftx(id+":BUFTX",pReg+U32_DataBufferControl, pReg+U8_DataBuffer_base),
@@ -583,6 +583,12 @@ evgMrm::getMxc(epicsUInt32 idx) {
     return m_muxCounter[idx];
 }
 
+evgTrigEvt*
+evgMrm::getTrigEvt(epicsUInt32 idx) {
+    if (idx >= m_trigEvt.size()) return NULL;
+    return m_trigEvt[idx];
+}
+
 evgAcTrig*
 evgMrm::getAcTrig() {
     return &m_acTrig;
@@ -154,6 +154,7 @@ public:
     const bus_configuration* getBusConfiguration();
     void resetFracSynth();
     evgMxc* getMxc(epicsUInt32 idx);
+    evgTrigEvt* getTrigEvt(epicsUInt32 idx);
     evgAcTrig* getAcTrig();
 
     CALLBACK                      irqExtInp_cb;
@@ -82,3 +82,19 @@ epicsUInt32 EvgSeqManager::testStartOfSeq()
     // SoS for sequencer 0 is bit 8
     return (NAT_READ32(base, IrqFlag)>>8)&0x3;
 }
+
+void EvgSeqManager::busEventCodes(bool *used) const
+{
+    // enabled trigger events
+    for(epicsUInt32 i=0; i<evgNumEvtTrig; i++) {
+        evgTrigEvt *trig = owner->getTrigEvt(i);
+        epicsUInt32 code = trig ? trig->getEvtCode() : 0u;
+        if(code)
+            used[code&0xff] = true;
+    }
+
+    // timestamping.  Seconds from software or DBus6/7, reset from trigger event or DBus5
+    used[0x70] = used[0x71] = true;
+    if(owner->getTSGenerator()!=0)
+        used[0x7d] = true;
+}
@@ -22,6 +22,8 @@ public:
 
     virtual epicsUInt32 testStartOfSeq();
 
+    virtual void busEventCodes(bool *used) const;
+
 private:
     evgMrm * const owner;
     volatile epicsUInt8 *base;
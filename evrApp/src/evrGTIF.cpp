@@ -16,6 +16,7 @@
 #include <errlog.h>
 #include <epicsMutex.h>
 #include <epicsGuard.h>
+#include <epicsAtomic.h>
 #include <epicsTime.h>
 #include <epicsVersion.h>
 #include <initHooks.h>
@@ -37,7 +38,8 @@ struct priv {
     priv(epicsTimeStamp *t, int e) : ok(S_time_unsynchronized), ts(t), event(e) {}
 };
 
-static EVR* lastSrc = 0;
+// Written with lastLock held.  Read without
+static EpicsAtomicPtrT lastSrc = 0;
 
 static epicsMutexId lastLock;
 
@@ -61,7 +63,7 @@ bool visitTime(mrf::Object* obj, void* raw)
     priv *p = (priv*)raw;
     bool tsok=evr->getTimeStamp(p->ts, p->event);
     if (tsok) {
-        lastSrc = evr;
+        epicsAtomicSetPtrT(&lastSrc, (EpicsAtomicPtrT)evr);
         p->ok=epicsTimeOK;
         return false;
     } else
@@ -71,15 +73,18 @@ bool visitTime(mrf::Object* obj, void* raw)
 extern "C"
 int EVREventTime(epicsTimeStamp *pDest, int event)
 {
+try {
+    // Common case.  Last source is still usable.
+    EVR *src = (EVR*)epicsAtomicGetPtrT(&lastSrc);
+    if(src && src->getTimeStamp(pDest, event))
+        return epicsTimeOK;
+} catch (std::exception& e) {
+    epicsPrintf("EVREventTime failed: %s\n", e.what());
+    return S_time_unsynchronized;
+}
 try {
     epicsMutexMustLock(lastLock);
 
-    if(lastSrc) {
-        if(lastSrc->getTimeStamp(pDest, event)) {
-            epicsMutexUnlock(lastLock);
-            return epicsTimeOK;
-        }
-    }
     priv p(pDest, event);
     mrf::Object::visitObjects(&visitTime, (void*)&p);
     epicsMutexUnlock(lastLock);
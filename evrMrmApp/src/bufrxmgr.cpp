@@ -19,25 +19,14 @@
 #include <epicsTypes.h>
 #include <cantProceed.h>
 #include <dbDefs.h>
+#include <epicsAtomic.h>
 #include "mrf/databuf.h"
+#include "mrf/cblanes.h"
 
 
 #include <epicsExport.h>
 #include "bufrxmgr.h"
 
-/* Subtract member byte offset, returning pointer to parent object */
-#ifndef CONTAINER
-# ifdef __GNUC__
-#   define CONTAINER(ptr, structure, member) ({                     \
-        const __typeof(((structure*)0)->member) *_ptr = (ptr);      \
-        (structure*)((char*)_ptr - offsetof(structure, member));    \
-    })
-# else
-#   define CONTAINER(ptr, structure, member) \
-        ((structure*)((char*)(ptr) - offsetof(structure, member)))
-# endif
-#endif
-
 #define CBINIT(ptr, prio, fn, valptr) \
 do { \
   callbackSetPriority(prio, ptr); \
@@ -60,68 +49,92 @@ void defaulterr(void *, epicsStatus err,
     }
 }
 
+// align buffers to cache lines
+#define BUF_ALIGN 64u
+
 bufRxManager::bufRxManager(const std::string& n, unsigned int qdepth, unsigned int bsize)
   :dataBufRx(n)
   ,guard()
+  ,dispatch(new dispatch_t)
   ,onerror(defaulterr)
   ,onerror_arg(NULL)
+  ,pool(qdepth)
+  ,storage(NULL)
+  ,stride(0u)
+  ,nextFree(0u)
+  ,usedbufs(qdepth)
+  ,consuming(0)
   ,m_bsize(bsize ? bsize : 2048)
 {
-    ellInit(&dispatch);
-    ellInit(&freebufs);
-    ellInit(&usedbufs);
-
     CBINIT(&received_cb, priorityMedium, &bufRxManager::received, this);
 
+    stride = (m_bsize+BUF_ALIGN-1u)&~size_t(BUF_ALIGN-1u);
+
+    storage=(epicsUInt8*)callocMustSucceed(1, stride*qdepth+BUF_ALIGN, "bufRxManager buffer");
+    epicsUInt8 *first = storage + (BUF_ALIGN - (size_t)storage%BUF_ALIGN)%BUF_ALIGN;
+
     for(unsigned int i=0; i<qdepth; i++) {
-        buffer *t=(buffer*)callocMustSucceed(1, sizeof(buffer)-1+m_bsize, "bufRxManager buffer");
-        ellAdd(&freebufs, &t->node);
+        pool[i].refs = 0;
+        pool[i].used = 0;
+        pool[i].data = first + i*stride;
     }
 }
 
 bufRxManager::~bufRxManager()
 {
-    ELLNODE *node, *next;
-
     SCOPED_LOCK(guard);
 
-    for(node=ellFirst(&freebufs), next=node ? ellNext(node):NULL;
-        node;
-        node=next, next=next ? ellNext(next) : NULL)
-    {
-        buffer *b=CONTAINER(node, buffer, node);
-        free(b);
-    }
+    free(storage);
+    delete dispatch;
+    for(size_t i=0; i<retired.size(); i++)
+        delete retired[i];
 }
 
 epicsUInt8*
 bufRxManager::getFree(unsigned int* blen)
 {
-    ELLNODE *node;
-    {
-        SCOPED_LOCK(guard);
-        node=ellGet(&freebufs);
-    }
+    for(size_t i=0; i<pool.size(); i++) {
+        buffer *buf = &pool[(nextFree+i)%pool.size()];
 
-    if (!node)
-        return NULL;
+        // claim for producer
+        if(epicsAtomicCmpAndSwapIntT(&buf->refs, 0, 1)!=0)
+            continue;
+
+        nextFree = (nextFree+i+1u)%pool.size();
 
-    buffer *buf=CONTAINER(node, buffer, node);
+        if (blen) *blen=bsize();
+
+        buf->used=0;
+        return buf->data;
+    }
 
-    if (blen) *blen=bsize();
+    return NULL;
+}
+
+bufRxManager::buffer*
+bufRxManager::lookup(const epicsUInt8* data)
+{
+    const epicsUInt8 *first = pool.empty() ? NULL : pool[0].data;
+    if(!first || data<first)
+        return NULL;
+    size_t idx = size_t(data-first)/stride;
+    if(idx>=pool.size() || pool[idx].data!=data)
+        return NULL;
+    return &pool[idx];
+}
 
-    buf->used=0;
-    return buf->data;
+void
+bufRxManager::release(buffer *buf)
+{
+    epicsAtomicDecrIntT(&buf->refs);
 }
 
 void
 bufRxManager::receive(epicsUInt8* raw,unsigned int usedlen)
 {
-    /* CONTAINER doesn't work when the member is a pointer
-     * because the GNU version's check isn't correct
-    buffer *buf=CONTAINER(raw, buffer, data);
-     */
-    buffer *buf=(buffer*)((char*)(raw) - offsetof(buffer, data));
+    buffer *buf=lookup(raw);
+    if(!buf)
+        throw std::invalid_argument("Not a Rx buffer");
 
     if (usedlen>bsize())
         throw std::out_of_range("User admitted overflowing Rx buffer");
@@ -129,22 +142,17 @@ bufRxManager::receive(epicsUInt8* raw,unsigned int usedlen)
 
     if (usedlen==0) {
         // buffer returned w/o being used
-        {
-            SCOPED_LOCK(guard);
-            ellAdd(&freebufs, &buf->node);
-        }
+        release(buf);
         if(evrMrmSeqRxDebug>=2) {
             errlogPrintf("buffer ignored\n");
         }
         return;
     }
 
-    {
-        SCOPED_LOCK(guard);
-        ellAdd(&usedbufs, &buf->node);
-    }
+    // can't fail as there are only as many buffers as ring slots
+    (void)usedbufs.push(buf);
 
-    callbackRequest(&received_cb);
+    mrf::laneRequest(&received_cb);
 }
 
 void
@@ -154,29 +162,67 @@ bufRxManager::received(CALLBACK* cb)
     callbackGetUser(vptr,cb);
     bufRxManager &self=*static_cast<bufRxManager*>(vptr);
 
-    SCOPED_LOCK2(self.guard, G);
+    // With parallel callback threads, received_cb may run concurrently.
+    // Only one at a time may consume from usedbufs.
+    while(epicsAtomicCmpAndSwapIntT(&self.consuming, 0, 1)==0) {
+        buffer *buf;
+
+        while(self.usedbufs.pop(buf)) {
+            const dispatch_t& D = *static_cast<dispatch_t*>(epicsAtomicGetPtrT((EpicsAtomicPtrT*)&self.dispatch));
+
+            self.invoke(D.all, buf);
+
+            // lookup listeners by Protocol ID (big endian) of each length
+            for(unsigned i=0, width=1u; i<3u; i++, width<<=1u) {
+                if(D.proto[i].empty() || buf->used<width)
+                    continue;
+                epicsUInt32 id = 0u;
+                for(unsigned b=0; b<width; b++)
+                    id = (id<<8u) | buf->data[b];
+                byproto_t::const_iterator it(D.proto[i].find(id));
+                if(it!=D.proto[i].end())
+                    self.invoke(it->second, buf);
+            }
+
+            self.release(buf);
+        }
 
-    while(true) {
-        ELLNODE *node=ellGet(&self.usedbufs);
+        epicsAtomicSetIntT(&self.consuming, 0);
 
-        if (!node)
+        // catch anything queued after we found usedbufs empty,
+        // but before we cleared consuming
+        if(self.usedbufs.empty())
             break;
-        buffer *buf=CONTAINER(node, buffer, node);
-
-        G.unlock();
+    }
+}
 
-        for(ELLNODE *cur=ellFirst(&self.dispatch); cur; cur=ellNext(cur)) {
-            listener *action=CONTAINER(cur, listener, node);
-            if(evrMrmSeqRxDebug>=3) {
-                errlogPrintf("buffer listener %p\n", action);
-            }
-            (action->fn)(action->fnarg, 0, buf->used, buf->data);
+void
+bufRxManager::invoke(const listeners_t& L, buffer *buf)
+{
+    for(listeners_t::const_iterator it(L.begin()), end(L.end()); it!=end; ++it) {
+        if(evrMrmSeqRxDebug>=3) {
+            errlogPrintf("buffer listener %p\n", it->fnarg);
         }
+        (it->fn)(it->fnarg, 0, buf->used, buf->data);
+    }
+}
 
-        G.lock();
+bool
+bufRxManager::dataRxHold(const epicsUInt8* data)
+{
+    buffer *buf=lookup(data);
+    if(!buf)
+        return false;
+    epicsAtomicIncrIntT(&buf->refs);
+    return true;
+}
 
-        ellAdd(&self.freebufs, &buf->node);
-    };
+void
+bufRxManager::dataRxRelease(const epicsUInt8* data)
+{
+    buffer *buf=lookup(data);
+    if(buf)
+        release(buf);
 }
 
 void
@@ -187,43 +233,97 @@ bufRxManager::dataRxError(dataBufComplete fn, void* arg)
     onerror_arg=arg;
 }
 
+// caller must hold guard
 void
-bufRxManager::dataRxAddReceive(dataBufComplete fn,void* arg)
+bufRxManager::setDispatch(dispatch_t *next)
 {
-    listener *l;
+    retired.push_back(dispatch);
+    epicsAtomicSetPtrT((EpicsAtomicPtrT*)&dispatch, next);
+}
+
+bufRxManager::listeners_t&
+bufRxManager::listFor(dispatch_t& D, unsigned width, epicsUInt32 id)
+{
+    switch(width) {
+    case 0: return D.all;
+    case 1: return D.proto[0][id];
+    case 2: return D.proto[1][id];
+    case 4: return D.proto[2][id];
+    default:
+        throw std::invalid_argument("Protocol ID width must be 1, 2, or 4");
+    }
+}
 
+void
+bufRxManager::addListener(unsigned width, epicsUInt32 id, dataBufComplete fn, void* arg)
+{
     SCOPED_LOCK(guard);
 
-    for(ELLNODE *node=ellFirst(&dispatch); node; node=ellNext(node))
+    mrf::auto_ptr<dispatch_t> next(new dispatch_t(*dispatch));
+    listeners_t& L = listFor(*next, width, id);
+
+    for(listeners_t::const_iterator it(L.begin()), end(L.end()); it!=end; ++it)
     {
-        l=CONTAINER(node, listener, node);
         // Don't add duplicates
-        if (l->fn==fn && l->fnarg==arg) {
+        if (it->fn==fn && it->fnarg==arg) {
             return;
         }
     }
 
-    l=new listener;
-    l->fn=fn;
-    l->fnarg=arg;
+    listener l;
+    l.fn=fn;
+    l.fnarg=arg;
+    L.push_back(l);
 
-    ellAdd(&dispatch, &l->node);
+    setDispatch(next.release());
 }
 
 void
-bufRxManager::dataRxDeleteReceive(dataBufComplete fn,void* arg)
+bufRxManager::delListener(unsigned width, epicsUInt32 id, dataBufComplete fn, void* arg)
 {
-    listener *l;
-
     SCOPED_LOCK(guard);
 
-    for(ELLNODE *node=ellFirst(&dispatch); node; node=ellNext(node))
+    mrf::auto_ptr<dispatch_t> next(new dispatch_t(*dispatch));
+    listeners_t& L = listFor(*next, width, id);
+
+    for(listeners_t::iterator it(L.begin()), end(L.end()); it!=end; ++it)
     {
-        l=CONTAINER(node, listener, node);
-        if (l->fn==fn && l->fnarg==arg) {
-            ellDelete(&dispatch, node);
-            delete l;
+        if (it->fn==fn && it->fnarg==arg) {
+            L.erase(it);
+            if(L.empty() && width) {
+                // don't leave empty entries to be found
+                next->proto[width==1 ? 0 : width==2 ? 1 : 2].erase(id);
+            }
+            setDispatch(next.release());
             return;
         }
     }
 }
+
+void
+bufRxManager::dataRxAddReceive(dataBufComplete fn,void* arg)
+{
+    addListener(0u, 0u, fn, arg);
+}
+
+void
+bufRxManager::dataRxDeleteReceive(dataBufComplete fn,void* arg)
+{
+    delListener(0u, 0u, fn, arg);
+}
+
+void
+bufRxManager::dataRxAddReceiveProto(unsigned width, epicsUInt32 id, dataBufComplete fn, void* arg)
+{
+    if(width==0u)
+        throw std::invalid_argument("Protocol ID width must be 1, 2, or 4");
+    addListener(width, id, fn, arg);
+}
+
+void
+bufRxManager::dataRxDeleteReceiveProto(unsigned width, epicsUInt32 id, dataBufComplete fn, void* arg)
+{
+    if(width==0u)
+        throw std::invalid_argument("Protocol ID width must be 1, 2, or 4");
+    delListener(width, id, fn, arg);
+}
@@ -13,11 +13,20 @@
 #define BUFRXMGR_H_INC
 
 
-#include <ellLib.h>
+#include <vector>
+#include <map>
+
 #include <callback.h>
 
 #include "mrf/databuf.h"
+#include "mrf/spscring.h"
 
+/* Pool of receive buffers.
+ *
+ * getFree() and receive() are called by a single producer (the Rx callback),
+ * received() dispatches to listeners.  Neither takes a lock.
+ * Buffers are reference counted so that listeners may hold them (dataRxHold()).
+ */
 class epicsShareClass bufRxManager : public dataBufRx
 {
 public:
@@ -27,8 +36,10 @@ public:
 
     unsigned int bsize(){return m_bsize;};
 
+    //! Claim an unused buffer.  NULL if all are in use
     epicsUInt8* getFree(unsigned int*);
 
+    //! Queue buffer from getFree() for dispatch
     void receive(epicsUInt8*,unsigned int);
 
     /**@brief Notification if Rx queue overflows
@@ -53,16 +64,37 @@ public:
      */
     virtual void dataRxDeleteReceive(dataBufComplete fptr, void* arg=0) OVERRIDE FINAL;
 
+    virtual void dataRxAddReceiveProto(unsigned width, epicsUInt32 id, dataBufComplete fptr, void* arg=0) OVERRIDE FINAL;
+    virtual void dataRxDeleteReceiveProto(unsigned width, epicsUInt32 id, dataBufComplete fptr, void* arg=0) OVERRIDE FINAL;
+
+    virtual bool dataRxHold(const epicsUInt8* buf) OVERRIDE FINAL;
+    virtual void dataRxRelease(const epicsUInt8* buf) OVERRIDE FINAL;
+
 private:
+    // guards changes to listeners and onerror
     epicsMutex guard;
 
     struct listener {
-        ELLNODE node;
-
         dataBufComplete fn;
         void *fnarg;
     };
-    ELLLIST dispatch;
+    typedef std::vector<listener> listeners_t;
+    typedef std::map<epicsUInt32, listeners_t> byproto_t;
+    struct dispatch_t {
+        // for all buffers
+        listeners_t all;
+        // by Protocol ID of 1, 2 and 4 bytes
+        byproto_t proto[3];
+    };
+    // Replaced (not modified) when listeners are added or removed, so received() may read without locking
+    dispatch_t *dispatch;
+    // previous dispatch tables, which received() may still be using.  Free'd by dtor
+    std::vector<dispatch_t*> retired;
+    void setDispatch(dispatch_t *next);
+    // find list for width and id.  width 0 for all buffers
+    static listeners_t& listFor(dispatch_t& D, unsigned width, epicsUInt32 id);
+    void addListener(unsigned width, epicsUInt32 id, dataBufComplete fn, void* arg);
+    void delListener(unsigned width, epicsUInt32 id, dataBufComplete fn, void* arg);
 
     dataBufComplete onerror;
     void* onerror_arg;
@@ -71,17 +103,28 @@ protected:
     void haderror(epicsStatus e){onerror(onerror_arg,e,0,NULL);}
 
 private:
-    ELLLIST freebufs;
-    ELLLIST usedbufs;
-
-    CALLBACK received_cb;
-    static void received(CALLBACK*);
-
     struct buffer {
-        ELLNODE node;
+        int refs; //!< 0 when free
         unsigned int used;
-        epicsUInt8 data[1]; //!< Actual length is bsize
+        epicsUInt8 *data; //!< bsize bytes, cache line aligned
     };
+    std::vector<buffer> pool;
+    epicsUInt8 *storage;
+    size_t stride;
+    // next pool entry getFree() tries.  Only used by producer
+    size_t nextFree;
+
+    buffer* lookup(const epicsUInt8* data);
+    void invoke(const listeners_t& L, buffer *buf);
+    void release(buffer *buf);
+
+    // Filled by receive(), emptied by received()
+    mrf::SPSCRing<buffer*> usedbufs;
+    // non-zero while received() is emptying usedbufs
+    int consuming;
+
+    CALLBACK received_cb;
+    static void received(CALLBACK*);
 
     const unsigned int m_bsize;
 };
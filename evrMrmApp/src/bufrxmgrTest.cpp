@@ -0,0 +1,246 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#include <vector>
+#include <utility>
+
+#include <callback.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#include "bufrxmgr.h"
+
+// normally defined in drvem.cpp
+int evrMrmSeqRxDebug;
+
+namespace {
+
+struct testRx : public bufRxManager
+{
+    explicit testRx(const std::string& n, unsigned qdepth, unsigned bsize)
+        :bufRxManager(n, qdepth, bsize)
+    {}
+    virtual ~testRx() {}
+    virtual void lock() const {}
+    virtual void unlock() const {}
+    virtual bool dataRxEnabled() const { return true; }
+    virtual void dataRxEnable(bool) {}
+};
+
+// claim every free buffer, then give them all back unused
+unsigned drain(testRx& rx)
+{
+    std::vector<epicsUInt8*> bufs;
+    epicsUInt8 *buf;
+    while((buf=rx.getFree(0))!=NULL)
+        bufs.push_back(buf);
+    for(size_t i=0; i<bufs.size(); i++)
+        rx.receive(bufs[i], 0u);
+    return unsigned(bufs.size());
+}
+
+// The dispatcher drops its reference after listeners return
+bool waitFree(testRx& rx, unsigned n)
+{
+    for(unsigned i=0; i<500u; i++) {
+        if(drain(rx)==n)
+            return true;
+        epicsThreadSleep(0.01);
+    }
+    return false;
+}
+
+void testClaim()
+{
+    testDiag("In testClaim()");
+    testRx rx("claim", 4u, 16u);
+
+    unsigned blen = 0u;
+    epicsUInt8 *bufs[4];
+    bool distinct = true;
+    for(unsigned i=0; i<4u; i++) {
+        bufs[i] = rx.getFree(&blen);
+        for(unsigned j=0; j<i; j++)
+            distinct &= bufs[i]!=bufs[j];
+    }
+    testOk1(bufs[0] && bufs[1] && bufs[2] && bufs[3]);
+    testOk(distinct, "distinct buffers");
+    testOk1(blen==16u);
+    testOk1(rx.getFree(0)==NULL);
+
+    // returned unused
+    rx.receive(bufs[2], 0u);
+    testOk1(rx.getFree(0)==bufs[2]);
+
+    for(unsigned i=0; i<4u; i++)
+        rx.receive(bufs[i], 0u);
+    testOk1(drain(rx)==4u);
+
+    testOk1(!rx.dataRxHold(bufs[0]+1));
+}
+
+struct holder {
+    testRx& rx;
+    epicsMutex lock;
+    epicsEvent wakeup;
+    // buffers held, and the sequence number each carried when received
+    std::vector<std::pair<const epicsUInt8*, epicsUInt32> > held;
+    epicsUInt32 expect;
+    unsigned nreceived, nbad;
+    explicit holder(testRx& rx) :rx(rx), expect(0u), nreceived(0u), nbad(0u) {}
+
+    static epicsUInt32 seqOf(const epicsUInt8* buf)
+    {
+        return (epicsUInt32(buf[1])<<24) | (epicsUInt32(buf[2])<<16)
+             | (epicsUInt32(buf[3])<<8) | buf[4];
+    }
+
+    static void cb(void *raw, epicsStatus ok, epicsUInt32 len, const epicsUInt8* buf)
+    {
+        holder *self = static_cast<holder*>(raw);
+        if(ok || len!=5u || !buf) {
+            SCOPED_LOCK2(self->lock, G);
+            self->nbad++;
+            return;
+        }
+        const epicsUInt32 seq = seqOf(buf);
+        bool held = self->rx.dataRxHold(buf);
+        {
+            SCOPED_LOCK2(self->lock, G);
+            if(!held || seq!=self->expect)
+                self->nbad++;
+            self->expect = seq+1u;
+            self->nreceived++;
+            if(held)
+                self->held.push_back(std::make_pair(buf, seq));
+        }
+        self->wakeup.signal();
+    }
+
+    // Release all held.  Returns number of buffers modified while held.
+    unsigned releaseAll()
+    {
+        std::vector<std::pair<const epicsUInt8*, epicsUInt32> > todo;
+        {
+            SCOPED_LOCK(lock);
+            todo.swap(held);
+        }
+        unsigned nmod = 0u;
+        for(size_t i=0; i<todo.size(); i++) {
+            if(seqOf(todo[i].first)!=todo[i].second)
+                nmod++;
+            rx.dataRxRelease(todo[i].first);
+        }
+        return nmod;
+    }
+};
+
+// wait for a free buffer, and queue it.  Gives up after ~5 seconds.
+bool send(testRx& rx, epicsUInt32 seq)
+{
+    epicsUInt8 *buf;
+    for(unsigned i=0u; (buf=rx.getFree(0))==NULL; i++) {
+        if(i>=1500u)
+            return false;
+        epicsThreadSleep(i<1000u ? 0.0 : 0.01);
+    }
+    buf[0] = 0x42;
+    buf[1] = seq>>24;
+    buf[2] = seq>>16;
+    buf[3] = seq>>8;
+    buf[4] = seq;
+    rx.receive(buf, 5u);
+    return true;
+}
+
+void testHold()
+{
+    testDiag("In testHold()");
+    testRx rx("hold", 2u, 16u);
+    holder H(rx);
+    rx.dataRxAddReceiveProto(1u, 0x42, &holder::cb, &H);
+
+    testOk1(send(rx, 0u));
+    testOk1(H.wakeup.wait(5.0));
+
+    // held buffer isn't reused, the other is free
+    epicsUInt8 *other = rx.getFree(0);
+    testOk1(other!=NULL);
+    testOk1(rx.getFree(0)==NULL);
+    rx.receive(other, 0u);
+
+    testOk1(H.releaseAll()==0u);
+    testOk1(waitFree(rx, 2u));
+
+    rx.dataRxDeleteReceiveProto(1u, 0x42, &holder::cb, &H);
+}
+
+struct producer : public epicsThreadRunable
+{
+    testRx& rx;
+    const epicsUInt32 count;
+    epicsEvent done;
+    producer(testRx& rx, epicsUInt32 count) :rx(rx), count(count) {}
+    virtual ~producer() {}
+    virtual void run()
+    {
+        for(epicsUInt32 i=0; i<count && send(rx, i); i++) {}
+        done.signal();
+    }
+};
+
+// Producer claims and queues while buffers are dispatched,
+// held by the listener, and released by this thread.
+void testConcurrent()
+{
+    testDiag("In testConcurrent()");
+    testRx rx("concurrent", 8u, 16u);
+    holder H(rx);
+    rx.dataRxAddReceive(&holder::cb, &H);
+
+    producer prod(rx, 100000u);
+    epicsThread thr(prod, "producer", epicsThreadGetStackSize(epicsThreadStackSmall));
+    thr.start();
+
+    // keep releasing until the producer is done, and the last is dispatched.
+    // Give up after 5 seconds without progress.
+    unsigned nmod = 0u;
+    bool done = false;
+    for(unsigned idle=0u; idle<500u; ) {
+        if(H.wakeup.wait(0.01))
+            idle = 0u;
+        else
+            idle++;
+        nmod += H.releaseAll();
+        done |= prod.done.tryWait();
+        SCOPED_LOCK2(H.lock, G);
+        if(done && H.nreceived>=prod.count)
+            break;
+    }
+    nmod += H.releaseAll();
+    testOk(done, "producer done");
+
+    testOk(H.nreceived==prod.count, "received %u of %u", H.nreceived, unsigned(prod.count));
+    testOk(H.nbad==0u, "%u out of order, or not held", H.nbad);
+    testOk(nmod==0u, "%u reused while held", nmod);
+    testOk1(waitFree(rx, 8u));
+
+    rx.dataRxDeleteReceive(&holder::cb, &H);
+}
+
+} // namespace
+
+MAIN(bufrxmgrTest)
+{
+    testPlan(18);
+    callbackInit();
+    testClaim();
+    testHold();
+    testConcurrent();
+    return testDone();
+}
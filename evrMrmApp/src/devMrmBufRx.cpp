@@ -59,8 +59,15 @@ struct s_priv
   epicsUInt32 proto;
   epicsUInt32 proto16;
   epicsUInt32 proto32;
+  // segmented data buffer.  seg is 0xffffffff when not used
+  epicsUInt32 seg;
+  epicsUInt32 nseg;
   char prop[20];
 
+  // registered with this Protocol ID length and value.  width 0 for all buffers
+  unsigned pwidth;
+  epicsUInt32 pid;
+
   dataBufRx *priv;
 
   epicsUInt32 blen;
@@ -74,6 +81,8 @@ linkOptionDef eventdef[] =
   linkInt32   (s_priv, proto, "Proto", 0, 0),
   linkInt32   (s_priv, proto16, "Proto16", 0, 0),
   linkInt32   (s_priv, proto32, "Proto32", 0, 0),
+  linkInt32   (s_priv, seg, "Seg", 0, 0),
+  linkInt32   (s_priv, nseg, "NSeg", 0, 0),
   linkString  (s_priv, prop , "P", 1, 0),
   linkOptionEnd
 };
@@ -92,6 +101,8 @@ try {
   paddr->proto = 0xff00;
   paddr->proto16 = 0;
   paddr->proto32 = 0;
+  paddr->seg = 0xffffffff;
+  paddr->nseg = 1;
 
   if (linkOptionsStore(eventdef, paddr.get(), prec->inp.value.instio.string, 0))
     throw std::runtime_error("Couldn't parse link string");
@@ -105,7 +116,28 @@ try {
   if(!paddr->priv)
     throw std::runtime_error("Failed to lookup device");
 
-  paddr->priv->dataRxAddReceive(datarx, praw);
+  // register for the most specific Protocol ID given, so that the
+  // receiver only calls us for matching buffers
+  if(paddr->proto32) {
+      paddr->pwidth = 4u;
+      paddr->pid = paddr->proto32;
+  } else if(paddr->proto16) {
+      paddr->pwidth = 2u;
+      paddr->pid = paddr->proto16;
+  } else if(paddr->proto != 0xff00) {
+      paddr->pwidth = 1u;
+      paddr->pid = paddr->proto;
+  } else {
+      paddr->pwidth = 0u;
+      paddr->pid = 0u;
+  }
+
+  if(paddr->seg!=0xffffffff)
+      paddr->priv->dataRxAddReceiveSegment(paddr->seg, paddr->nseg, datarx, praw);
+  else if(paddr->pwidth)
+      paddr->priv->dataRxAddReceiveProto(paddr->pwidth, paddr->pid, datarx, praw);
+  else
+      paddr->priv->dataRxAddReceive(datarx, praw);
 
   // prec->dpvt is set again to indicate
   // This also serves to indicate successful
@@ -133,7 +165,12 @@ static long del_record_waveform(dbCommon *praw)
         mrf::auto_ptr<s_priv> paddr(static_cast<s_priv*>(praw->dpvt));
         praw->dpvt = 0;
 
-        paddr->priv->dataRxDeleteReceive(datarx, praw);
+        if(paddr->seg!=0xffffffff)
+            paddr->priv->dataRxDeleteReceiveSegment(paddr->seg, paddr->nseg, datarx, praw);
+        else if(paddr->pwidth)
+            paddr->priv->dataRxDeleteReceiveProto(paddr->pwidth, paddr->pid, datarx, praw);
+        else
+            paddr->priv->dataRxDeleteReceive(datarx, praw);
 
     } catch(std::runtime_error& e) {
         recGblRecordError(S_dev_noDevice, (void*)praw, e.what());
@@ -152,10 +189,14 @@ void datarx(void *arg, epicsStatus ok,
     waveformRecord* prec=(waveformRecord*)arg;
     s_priv *paddr=static_cast<s_priv*>(prec->dpvt);
 
-    //check protocol id
-    if (paddr->proto != 0xff00 && paddr->proto != buf[0]) return;
-    if (paddr->proto16 && paddr->proto16 != ntohs(((epicsUInt16*)buf)[0])) return;
-    if (paddr->proto32 && paddr->proto32 != ntohl(((epicsUInt32*)buf)[0])) return;
+    // check protocol id.
+    // Usually already matched by the receiver, unless more than one is given.
+    // No buffer on error (segment checksum error)
+    if (!ok) {
+        if (paddr->proto != 0xff00 && paddr->proto != buf[0]) return;
+        if (paddr->proto16 && paddr->proto16 != ntohs(((epicsUInt16*)buf)[0])) return;
+        if (paddr->proto32 && paddr->proto32 != ntohl(((epicsUInt32*)buf)[0])) return;
+    }
 
     dbScanLock((dbCommon*)prec);
 
@@ -13,6 +13,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cmath>
+#include <ctime>
 #include <stdexcept>
 #include <algorithm>
 #include <sstream>
@@ -23,6 +24,7 @@
 #include <dbDefs.h>
 #include <dbScan.h>
 #include <epicsInterrupt.h>
+#include <epicsAtomic.h>
 
 #include "mrmDataBufTx.h"
 #include "sfp.h"
@@ -59,16 +61,35 @@
 #  define HAVE_PARALLEL_CB
 #endif
 
+/* whether I/O Intr scans can be run from our own threads
+ * (mrfCallbackLanes()) instead of the callback queues.
+ */
+#if EPICS_VERSION_INT>=VERSION_INT(3,16,1,0)
+#  define HAVE_SCANIO_IMMEDIATE
+#endif
+
 int evrMrmTimeDebug;
 int evrMrmSeqRxDebug;
 //! value in nanoseconds above which a timestamp is considered invalid.
 //! below is truncated.  May be necessary when simulating timestamp
 //! source in software
 int evrMrmTimeNSOverflowThreshold;
+//! Non-zero to interpolate current time between hardware latches
+//! using a local monotonic clock, instead of latching for each request.
+int evrMrmTimeInterp;
+//! Interpolated time is only used while the error (in nanoseconds)
+//! measured at the last hardware latch is below this value.
+double evrMrmTimeInterpMaxErr = 10000.0;
+//! Non-zero to allow wide (16 byte) reads of the data buffer on PCI EVRs.
+//! Set to 0 if a bridge does not handle these.
+int evrMrmDataRxWide = 1;
 extern "C" {
  epicsExportAddress(int, evrMrmSeqRxDebug);
  epicsExportAddress(int, evrMrmTimeDebug);
  epicsExportAddress(int, evrMrmTimeNSOverflowThreshold);
+ epicsExportAddress(int, evrMrmTimeInterp);
+ epicsExportAddress(double, evrMrmTimeInterpMaxErr);
+ epicsExportAddress(int, evrMrmDataRxWide);
 }
 
 using namespace std;
@@ -105,6 +126,9 @@ extern "C" {
      * Set to 0.0 to disable
      *
      * No point in making this shorter than the system tick
+     *
+     * This is the longest sleep.  drain_fifo() only sleeps while
+     * the FIFO event rate exceeds the "FIFO Rate Budget" of the EVR.
      */
     double mrmEvrFIFOPeriod = 1.0/ 1000.0; /* 1/rate in Hz */
 
@@ -114,6 +138,11 @@ extern "C" {
 /* Number of good updates before the time is considered valid */
 #define TSValidThreshold 5
 
+/* Interpolated time is not used this long (ns) after the last latch.
+ * Normally a latch is made on each seconds tick.
+ */
+#define TSInterpMaxAge 1500000000u
+
 /* GTX output offset [FPUniv] */
 #define GTX_FPUV_OFFSET 16
 /* GTX SFP output offset [on MTCA RF card]*/
@@ -129,8 +158,9 @@ EVRMRM::EVRMRM(const std::string& n,
                epicsUInt32 bl)
   :base_t(n,busConfig)
   ,MRMSPI(b+U32_SPIDData)
-  ,TimeStampSource(1.0)
+  ,TimeStampSource(1.0, n)
   ,evrLock()
+  ,dispatchLock()
   ,conf(c)
   ,base(b)
   ,baselen(bl)
@@ -146,12 +176,41 @@ EVRMRM::EVRMRM(const std::string& n,
   ,pulsers()
   ,shortcmls()
   ,gpio_(*this)
+  ,sched_fifo(n+":Sched:FIFO")
+  ,sched_dispatch(n+":Sched:Dispatch")
+  ,sched_poll(n+":Sched:Poll")
+  ,sched_isrpoll(n+":Sched:IRQPoll")
   ,drain_fifo_method(*this)
   ,drain_fifo_task(drain_fifo_method, "EVRFIFO",
                    epicsThreadGetStackSize(epicsThreadStackBig),
                    epicsThreadPriorityHigh )
   // 3 because 2 IRQ events, and 1 shutdown event
   ,drain_fifo_wakeup(3,sizeof(int))
+  ,busyPoll(false)
+  ,pollIRQMask(0u)
+  ,pace_last(0u)
+  ,pace_codelast(0u)
+  ,pace_count(0u)
+  ,pace_sleep(0.0)
+  ,pace_limit(10000.0)
+  ,pace_budget(10000.0)
+  ,pace_rate(0.0)
+  ,pace_backoff(0.0)
+  ,pace_topcode(0u)
+  ,pace_toprate(0.0)
+  ,pace_coderate(256u, 0.0)
+  // at least twice the hardware FIFO depth
+  ,fifo_ring(2048)
+  ,dispatch_fifo_method(*this)
+  ,dispatch_fifo_task(dispatch_fifo_method, "EVRFIFOD",
+                      epicsThreadGetStackSize(epicsThreadStackBig),
+                      epicsThreadPriorityHigh )
+  ,dispatch_fifo_stop(0)
+  ,latencyEna(0)
+  ,latCode(0u)
+  ,lat_isr(0u)
+  ,latHist(256u*LatNStages*LatNBuckets, 0u)
+  ,latResetReq(0)
   ,count_FIFO_sw_overrate(0)
   ,timeSrcMode(Disable)
   ,stampClock(0.0)
@@ -160,6 +219,8 @@ EVRMRM::EVRMRM(const std::string& n,
   ,timestampValid(0)
   ,lastInvalidTimestamp(0)
   ,lastValidTimestamp(0)
+  ,interpErr(0.0)
+  ,interpErrMax(0.0)
 {
 try{
     const epicsUInt32 rawver = fpgaFirmware();
@@ -188,6 +249,8 @@ try{
     scanIoInit(&timestampValidChange);
 
     CBINIT(&data_rx_cb   , priorityHigh, &mrmBufRx::drainbuf, &this->bufrx);
+    bufrx.setWideRead(busConfig.busType==busType_pci && evrMrmDataRxWide);
+    CBINIT(&seg_rx_cb    , priorityHigh, &EVRMRM::seg_rx, this);
     CBINIT(&poll_link_cb , priorityMedium, &EVRMRM::poll_link , this);
 
     if(ver>=MRFVersion(0, 5)) {
@@ -197,6 +260,9 @@ try{
     if(ver>=MRFVersion(2,7)) {
         printf("Sequencer capability detected\n");
         seq.reset(new EvrSeqManager(this));
+
+        printf("Segmented data buffer capability detected\n");
+        bufrx.enableSegments();
     }
 
     /*
@@ -306,51 +372,58 @@ try{
         events[i].code=i;
         events[i].owner=this;
         CBINIT(&events[i].done_cb, priorityLow, &EVRMRM::sentinel_done , &events[i]);
+        CBINIT(&events[i].lane_cb, priorityHigh, &EVRMRM::lane_invoke , &events[i]);
     }
 
-    SCOPED_LOCK(evrLock);
+    {
+        SCOPED_LOCK(evrLock);
 
-    memset(_mapped, 0, sizeof(_mapped));
-    // restore mapping ram to a clean state
-    // needed when the IOC is started w/o a device reset (ie Linux)
-    //TODO: find a way to do this that doesn't require clearing
-    //      mapping which will shortly be set again...
-    for(size_t i=0; i<255; i++) {
-        WRITE32(base, MappingRam(0, i, Internal), 0);
-        WRITE32(base, MappingRam(0, i, Trigger), 0);
-        WRITE32(base, MappingRam(0, i, Set), 0);
-        WRITE32(base, MappingRam(0, i, Reset), 0);
-    }
+        memset(_mapped, 0, sizeof(_mapped));
+        // restore mapping ram to a clean state
+        // needed when the IOC is started w/o a device reset (ie Linux)
+        //TODO: find a way to do this that doesn't require clearing
+        //      mapping which will shortly be set again...
+        for(size_t i=0; i<255; i++) {
+            WRITE32(base, MappingRam(0, i, Internal), 0);
+            WRITE32(base, MappingRam(0, i, Trigger), 0);
+            WRITE32(base, MappingRam(0, i, Set), 0);
+            WRITE32(base, MappingRam(0, i, Reset), 0);
+        }
 
-    // restore default special mappings
-    // These may be replaced later
-    specialSetMap(MRF_EVENT_TS_SHIFT_0,     96, true);
-    specialSetMap(MRF_EVENT_TS_SHIFT_1,     97, true);
-    specialSetMap(MRF_EVENT_TS_COUNTER_INC, 98, true);
-    specialSetMap(MRF_EVENT_TS_COUNTER_RST, 99, true);
-    specialSetMap(MRF_EVENT_HEARTBEAT,      101, true);
+        // restore default special mappings
+        // These may be replaced later
+        specialSetMap(MRF_EVENT_TS_SHIFT_0,     96, true);
+        specialSetMap(MRF_EVENT_TS_SHIFT_1,     97, true);
+        specialSetMap(MRF_EVENT_TS_COUNTER_INC, 98, true);
+        specialSetMap(MRF_EVENT_TS_COUNTER_RST, 99, true);
+        specialSetMap(MRF_EVENT_HEARTBEAT,      101, true);
 
-    // Except for Prescaler reset, which is set with a record
-    specialSetMap(MRF_EVENT_RST_PRESCALERS, 100, false);
+        // Except for Prescaler reset, which is set with a record
+        specialSetMap(MRF_EVENT_RST_PRESCALERS, 100, false);
 
-    eventClock=FracSynthAnalyze(READ32(base, FracDiv),
-                                fracref,0)*1e6;
+        eventClock=FracSynthAnalyze(READ32(base, FracDiv),
+                                    fracref,0)*1e6;
 
-    shadowCounterPS=READ32(base, CounterPS);
+        shadowCounterPS=READ32(base, CounterPS);
 
-    if(tsDiv()!=0) {
-        shadowSourceTS=TSSourceInternal;
-    } else {
-        bool usedbus4=(READ32(base, Control) & Control_tsdbus) != 0;
+        if(tsDiv()!=0) {
+            shadowSourceTS=TSSourceInternal;
+        } else {
+            bool usedbus4=(READ32(base, Control) & Control_tsdbus) != 0;
 
-        if(usedbus4)
-            shadowSourceTS=TSSourceDBus4;
-        else
-            shadowSourceTS=TSSourceEvent;
+            if(usedbus4)
+                shadowSourceTS=TSSourceDBus4;
+            else
+                shadowSourceTS=TSSourceEvent;
+        }
+
+        updateTickScale();
     }
 
+    // takes dispatchLock, so not while holding evrLock
     eventNotifyAdd(MRF_EVENT_TS_COUNTER_RST, &seconds_tick, (void*)this);
 
+    dispatch_fifo_task.start();
     drain_fifo_task.start();
 
     if(busConfig.busType==busType_pci || (busConfig.busType==busType_vme && version()>=MRFVersion(2, 0, 0)))
@@ -378,10 +451,16 @@ void
 EVRMRM::cleanup()
 {
     printf("%s shuting down... ", name().c_str());
+    busyPoller.reset();
+
     int wakeup=1;
     drain_fifo_wakeup.send(&wakeup, sizeof(wakeup));
     drain_fifo_task.exitWait();
 
+    epicsAtomicSetIntT(&dispatch_fifo_stop, 1);
+    dispatch_fifo_wakeup.signal();
+    dispatch_fifo_task.exitWait();
+
     for(outputs_t::iterator it=outputs.begin();
         it!=outputs.end(); ++it)
     {
@@ -593,6 +672,7 @@ void EVRMRM::clockSet(double freq)
         double clk = FracSynthAnalyze(READ32(base, FracDiv), fracref,0) * 1e6;
         // Apply the soft clock if the registry is not implemented (EVRD/U)
         eventClock = (clk == 0.0) ? clk_soft : clk;
+        updateTickScale();
     }
 
     printf("Set EVR %s %s clock %f newfrac %d (oldfrac %d)\n", model().c_str(), name().c_str(), eventClock, newfrac, oldfrac);
@@ -727,6 +807,15 @@ EVRMRM::setSourceTS(TSSource src)
     WRITE32(base, CounterPS, div);
     shadowCounterPS=div;
     shadowSourceTS=src;
+    updateTickScale();
+    timeAnchor.store(timeAnchor_t());
+}
+
+// Caller must hold evrLock
+void
+EVRMRM::updateTickScale()
+{
+    tickscale.store(TickScale(clockTS()));
 }
 
 double
@@ -775,6 +864,8 @@ EVRMRM::clockTSSet(double clk)
     }
 
     stampClock=clk;
+    updateTickScale();
+    timeAnchor.store(timeAnchor_t());
 }
 
 bool
@@ -782,7 +873,7 @@ EVRMRM::interestedInEvent(epicsUInt32 event,bool set)
 {
     if (!event || event>255) return false;
 
-    eventCode *entry=&events[event];
+    eventCodeConfig *entry=&eventConfigs[event];
 
     SCOPED_LOCK(evrLock);
 
@@ -803,8 +894,7 @@ EVRMRM::interestedInEvent(epicsUInt32 event,bool set)
 bool
 EVRMRM::TimeStampValid() const
 {
-    SCOPED_LOCK(evrLock);
-    return timestampValid>=TSValidThreshold;
+    return epicsAtomicGetIntT(&timestampValid)>=TSValidThreshold;
 }
 
 bool
@@ -813,59 +903,279 @@ EVRMRM::getTimeStamp(epicsTimeStamp *ret,epicsUInt32 event)
     if(!ret) throw std::runtime_error("Invalid argument");
     epicsTimeStamp ts;
 
-    SCOPED_LOCK(evrLock);
-    if(timestampValid<TSValidThreshold) return false;
-
     if(event>0 && event<=255) {
         // Get time of last event code #
+        // Converted by dispatch_one(), so no need for evrLock
 
-        eventCode *entry=&events[event];
+        if(!TimeStampValid()) return false;
 
         // Fail if event is not mapped
-        if (!entry->interested ||
-            ( entry->last_sec==0 &&
-              entry->last_evt==0) )
-        {
+        if (!epicsAtomicGetSizeT(&eventConfigs[event].interested))
             return false;
-        }
 
-        ts.secPastEpoch=entry->last_sec;
-        ts.nsec=entry->last_evt;
+        eventCode::lastTime_t last(events[event].last.load());
+        if(!last.ok)
+            return false;
 
+        *ret = last.time;
+        return true;
 
     } else {
         // Get current absolute time
+        if(evrMrmTimeInterp && interpolateTime(ret))
+            return true;
+
+        SCOPED_LOCK(evrLock);
+        if(timestampValid<TSValidThreshold) return false;
+
+        if(!latchTime(&ts))
+            return false;
+    }
+
+    *ret = ts;
+    return true;
+}
+
+/* Latch and read the current time.
+ * When interpolation is enabled, also (re)anchor interpolation.
+ * Caller must hold evrLock
+ */
+bool
+EVRMRM::latchTime(epicsTimeStamp *ts)
+{
+    epicsUInt64 t0=0u, t1=0u;
+    bool anchor = evrMrmTimeInterp && mrfLocalMonotonic(&t0);
+
+    epicsUInt32 ctrl=READ32(base, Control);
+
+    // Latch timestamp
+    WRITE32(base, Control, ctrl|Control_tsltch);
+
+    ts->secPastEpoch=READ32(base, TSSecLatch);
+    ts->nsec=READ32(base, TSEvtLatch);
+
+    if(anchor)
+        anchor = mrfLocalMonotonic(&t1);
+
+    /* BUG: There was a firmware bug which occasionally
+     * causes the previous write to fail with a VME bus
+     * error, and 0 the Control register.
+     *
+     * This issues has been fixed in VME firmwares EVRv 5
+     * pre2 and EVG v3 pre2.  Feb 2011
+     */
+    epicsUInt32 ctrl2=READ32(base, Control);
+    if (ctrl2!=ctrl) { // tsltch bit is write-only
+        printf("Get timestamp: control register write fault. Written: %08x, readback: %08x\n",ctrl,ctrl2);
+        WRITE32(base, Control, ctrl);
+        anchor = false;
+    }
 
-        epicsUInt32 ctrl=READ32(base, Control);
-
-        // Latch timestamp
-        WRITE32(base, Control, ctrl|Control_tsltch);
-
-        ts.secPastEpoch=READ32(base, TSSecLatch);
-        ts.nsec=READ32(base, TSEvtLatch);
-
-        /* BUG: There was a firmware bug which occasionally
-         * causes the previous write to fail with a VME bus
-         * error, and 0 the Control register.
-         *
-         * This issues has been fixed in VME firmwares EVRv 5
-         * pre2 and EVG v3 pre2.  Feb 2011
-         */
-        epicsUInt32 ctrl2=READ32(base, Control);
-        if (ctrl2!=ctrl) { // tsltch bit is write-only
-            printf("Get timestamp: control register write fault. Written: %08x, readback: %08x\n",ctrl,ctrl2);
-            WRITE32(base, Control, ctrl);
+    if(!convertTS(ts))
+        return false;
+
+    if(anchor)
+        anchorTime(*ts, t0, t1);
+    return true;
+}
+
+/* Record a new interpolation anchor, and measure the error
+ * of interpolation from the previous anchor.
+ * t0 and t1 are local times before and after the latch.
+ * Caller must hold evrLock
+ */
+void
+EVRMRM::anchorTime(const epicsTimeStamp& ts, epicsUInt64 t0, epicsUInt64 t1)
+{
+    const timeAnchor_t prev(timeAnchor.load());
+    timeAnchor_t next;
+
+    next.mono = t0 + (t1-t0)/2u;
+    next.evr = ts;
+    // uncertainty of when the latch happened
+    double window = double(t1-t0)/2.0;
+
+    if(prev.mono==0u || prev.mono>=next.mono) {
+        // first latch, or after a clock change
+        next.rmono = next.mono;
+        next.revr = next.evr;
+        next.rate = 1.0;
+        next.rated = false;
+        next.ok = false;
+
+    } else {
+        // predict from previous anchor and compare
+        double local = double(next.mono - prev.mono);
+        double actual = epicsTimeDiffInSeconds(&next.evr, &prev.evr)*1e9;
+
+        interpErr = fabs(actual - local*prev.rate) + window;
+        if(interpErr > interpErrMax)
+            interpErrMax = interpErr;
+
+        next.rmono = prev.rmono;
+        next.revr = prev.revr;
+        next.rate = prev.rate;
+        next.rated = prev.rated;
+
+        // re-estimate rate over a baseline of at least half a second
+        double baseline = double(next.mono - prev.rmono);
+        if(baseline >= 0.5e9) {
+            double rate = epicsTimeDiffInSeconds(&next.evr, &prev.revr)*1e9/baseline;
+
+            // ignore nonsense.  eg. a step in EVR time
+            if(fabs(rate-1.0) < 1e-3) {
+                next.rate = rate;
+                next.rated = true;
+            }
+            next.rmono = next.mono;
+            next.revr = next.evr;
         }
 
+        next.ok = next.rated && interpErr <= evrMrmTimeInterpMaxErr;
+
+        if(!next.ok && prev.ok && evrMrmTimeDebug>0)
+            errlogPrintf("TS interpolation error %f ns exceeds limit\n", interpErr);
     }
 
-    if(!convertTS(&ts))
+    timeAnchor.store(next);
+}
+
+/* Current time from the last anchor and the local monotonic clock.
+ * Does not lock.
+ */
+bool
+EVRMRM::interpolateTime(epicsTimeStamp *ts) const
+{
+    epicsUInt64 now;
+
+    if(!TimeStampValid() || !mrfLocalMonotonic(&now))
         return false;
 
-    *ret = ts;
+    const timeAnchor_t A(timeAnchor.load());
+
+    if(!A.ok || now<A.mono || now-A.mono > TSInterpMaxAge)
+        return false;
+
+    epicsUInt64 nsec = A.evr.nsec + epicsUInt64(double(now-A.mono)*A.rate);
+
+    ts->secPastEpoch = A.evr.secPastEpoch + epicsUInt32(nsec/1000000000u);
+    ts->nsec = epicsUInt32(nsec%1000000000u);
     return true;
 }
 
+double
+EVRMRM::timeInterpErr() const
+{
+    SCOPED_LOCK(evrLock);
+    return interpErr;
+}
+
+double
+EVRMRM::timeInterpErrMax() const
+{
+    SCOPED_LOCK(evrLock);
+    return interpErrMax;
+}
+
+bool
+EVRMRM::latencyEnabled() const
+{
+    return epicsAtomicGetIntT(&latencyEna);
+}
+
+void
+EVRMRM::latencyEnable(bool v)
+{
+    epicsAtomicSetIntT(&latencyEna, v);
+}
+
+void
+EVRMRM::latencyCodeSet(epicsUInt32 v)
+{
+    if(v>255)
+        throw std::out_of_range("Event code out of range");
+    latCode = v;
+}
+
+// Called with evrLock held, so can't take dispatchLock
+void
+EVRMRM::latencyReset()
+{
+    epicsAtomicSetIntT(&latResetReq, 1);
+}
+
+// Caller must hold dispatchLock
+void
+EVRMRM::latencyRecord(epicsUInt32 code, latStage_t stage, epicsUInt64 start, epicsUInt64 end)
+{
+    if(epicsAtomicCmpAndSwapIntT(&latResetReq, 1, 0)==1)
+        std::fill(latHist.begin(), latHist.end(), 0u);
+    if(!start || end<start)
+        return;
+    epicsUInt64 delta = (end-start)>>1u;
+    unsigned bucket = 0u;
+    while(delta && bucket<LatNBuckets-1u) {
+        delta >>= 1u;
+        bucket++;
+    }
+    // single 32-bit store, so lockless readers see either old or new count
+    latHist[(code*LatNStages + stage)*LatNBuckets + bucket]++;
+}
+
+void
+EVRMRM::latencyHist(epicsUInt32 code, latStage_t stage, epicsUInt32 *arr) const
+{
+    if(code>255 || stage>=LatNStages)
+        throw std::out_of_range("Invalid event code or stage");
+
+    epicsUInt32 first = code ? code : 1u,
+                last  = code ? code : 255u;
+
+    std::fill(arr, arr+LatNBuckets, 0u);
+    // reset not yet applied
+    if(epicsAtomicGetIntT(&latResetReq))
+        return;
+    for(epicsUInt32 c=first; c<=last; c++) {
+        const epicsUInt32 *hist = &latHist[(c*LatNStages + stage)*LatNBuckets];
+        for(unsigned i=0; i<LatNBuckets; i++)
+            arr[i] += hist[i];
+    }
+}
+
+epicsUInt32
+EVRMRM::latencyProp(latStage_t stage, epicsUInt32 *arr, epicsUInt32 count) const
+{
+    epicsUInt32 hist[LatNBuckets];
+    latencyHist(latCode, stage, hist);
+    count = std::min(count, epicsUInt32(LatNBuckets));
+    std::copy(hist, hist+count, arr);
+    return count;
+}
+
+epicsUInt32
+EVRMRM::latencyIRQ(epicsUInt32 *arr, epicsUInt32 count) const
+{
+    return latencyProp(LatIRQ, arr, count);
+}
+
+epicsUInt32
+EVRMRM::latencyDispatch(epicsUInt32 *arr, epicsUInt32 count) const
+{
+    return latencyProp(LatDispatch, arr, count);
+}
+
+epicsUInt32
+EVRMRM::latencyCallback(epicsUInt32 *arr, epicsUInt32 count) const
+{
+    return latencyProp(LatCallback, arr, count);
+}
+
+epicsUInt32
+EVRMRM::latencyTotal(epicsUInt32 *arr, epicsUInt32 count) const
+{
+    return latencyProp(LatTotal, arr, count);
+}
+
 /** @brief In place conversion between raw posix sec+ticks to EPICS sec+nsec.
  @returns false if conversion failed
  */
@@ -904,12 +1214,14 @@ EVRMRM::convertTS(epicsTimeStamp* ts)
     }
 
     // Convert ticks to nanoseconds
-    double period=1e9/clockTS(); // in nanoseconds
+    const TickScale scale(tickScale());
 
-    if(period<=0 || !isfinite(period))
+    if(!scale.valid())
         return false;
 
-    ts->nsec=(epicsUInt32)(ts->nsec*period);
+    epicsUInt64 nsec=scale.toNS(ts->nsec);
+    // saturate.  Anything this large is out of bounds anyway
+    ts->nsec = nsec>0xffffffffu ? 0xffffffffu : epicsUInt32(nsec);
 
     // 1 sec. reset is late
     if(ts->nsec>=1000000000u) {
@@ -962,9 +1274,10 @@ EVRMRM::eventNotifyAdd(epicsUInt32 event, eventCallback cb, void* arg)
     if (event==0 || event>255)
         throw std::out_of_range("Invalid event number");
 
-    SCOPED_LOCK2(evrLock, guard);
-
-    events[event].notifiees.push_back( std::make_pair(cb,arg));
+    {
+        SCOPED_LOCK(dispatchLock);
+        events[event].notifiees.push_back( std::make_pair(cb,arg));
+    }
 
     interestedInEvent(event, true);
 }
@@ -975,9 +1288,10 @@ EVRMRM::eventNotifyDel(epicsUInt32 event, eventCallback cb, void* arg)
     if (event==0 || event>255)
         throw std::out_of_range("Invalid event number");
 
-    SCOPED_LOCK2(evrLock, guard);
-
-    events[event].notifiees.remove(std::make_pair(cb,arg));
+    {
+        SCOPED_LOCK(dispatchLock);
+        events[event].notifiees.remove(std::make_pair(cb,arg));
+    }
 
     interestedInEvent(event, false);
 }
@@ -1170,6 +1484,21 @@ void EVRMRM::setTimeSrc(epicsUInt32 raw)
 OBJECT_BEGIN2(EVRMRM, EVR)
   OBJECT_PROP2("Clock Mode", &EVRMRM::clockMode, &EVRMRM::clockModeSet);
   OBJECT_PROP2("DCEnable", &EVRMRM::dcEnabled, &EVRMRM::dcEnable);
+  OBJECT_PROP1("FIFO Over Rate Codes", &EVRMRM::FIFOOverRateCodes);
+  OBJECT_PROP1("FIFO Decimated Codes", &EVRMRM::FIFODecimatedCodes);
+  OBJECT_PROP2("FIFO Rate Budget", &EVRMRM::FIFORateBudget, &EVRMRM::FIFORateBudgetSet);
+  OBJECT_PROP1("FIFO Rate", &EVRMRM::FIFORate);
+  OBJECT_PROP1("FIFO Backoff", &EVRMRM::FIFOBackoff);
+  OBJECT_PROP1("FIFO Top Code", &EVRMRM::FIFOTopCode);
+  OBJECT_PROP1("FIFO Top Rate", &EVRMRM::FIFOTopRate);
+  OBJECT_PROP1("FIFO Code Rates", &EVRMRM::FIFOCodeRates);
+  OBJECT_PROP2("Latency Enable", &EVRMRM::latencyEnabled, &EVRMRM::latencyEnable);
+  OBJECT_PROP2("Latency Code", &EVRMRM::latencyCode, &EVRMRM::latencyCodeSet);
+  OBJECT_PROP1("Latency Reset", &EVRMRM::latencyReset);
+  OBJECT_PROP1("Latency IRQ", &EVRMRM::latencyIRQ);
+  OBJECT_PROP1("Latency Dispatch", &EVRMRM::latencyDispatch);
+  OBJECT_PROP1("Latency Callback", &EVRMRM::latencyCallback);
+  OBJECT_PROP1("Latency Total", &EVRMRM::latencyTotal);
   OBJECT_PROP2("FifoReset", &EVRMRM::fifoResetGet, &EVRMRM::fifoResetSet);
   OBJECT_PROP2("DCTarget", &EVRMRM::dcTarget, &EVRMRM::dcTargetSet);
   OBJECT_PROP1("DCRx",     &EVRMRM::dcRx);
@@ -1194,24 +1523,68 @@ OBJECT_BEGIN2(EVRMRM, EVR)
       OBJECT_PROP1("Sync TS", cmd);
     }
   OBJECT_PROP2("PLL Bandwidth", &EVRMRM::getPLLBandwidth, &EVRMRM::setPLLBandwidth);
+  OBJECT_PROP1("Time Interp Err", &EVRMRM::timeInterpErr);
+  OBJECT_PROP1("Time Interp Err Max", &EVRMRM::timeInterpErrMax);
+  OBJECT_PROP1("DBuf Seg Updates", &EVRMRM::dbufSegUpdates);
+  OBJECT_PROP1("DBuf Seg Overflows", &EVRMRM::dbufSegOverflows);
+  OBJECT_PROP1("DBuf Seg Errors", &EVRMRM::dbufSegErrors);
 OBJECT_END(EVRMRM)
 
 
 void
 EVRMRM::enableIRQ(void)
 {
-    interruptLock I;
+    {
+        interruptLock I;
 
-    shadowIRQEna =  IRQ_Enable
-                   |IRQ_RXErr    |IRQ_BufFull
-                   |IRQ_Heartbeat
-                   |IRQ_Event    |IRQ_FIFOFull
-                   |IRQ_SoS      |IRQ_EoS;
+        shadowIRQEna =  IRQ_Enable
+                       |IRQ_RXErr    |IRQ_BufFull
+                       |IRQ_Heartbeat
+                       |IRQ_Event    |IRQ_FIFOFull
+                       |IRQ_SoS      |IRQ_EoS;
 
-    // IRQ PCIe enable flag should not be changed. Possible RACER here
-    shadowIRQEna |= (IRQ_PCIee & (READ32(base, IRQEnable)));
+        if(bufrx.dataRxSegments())
+            shadowIRQEna |= IRQ_SegDBuf;
+
+        if(busyPoll) {
+            // FIFO is handled by poll_fifo()
+            pollIRQMask = IRQ_Event|IRQ_FIFOFull;
+            shadowIRQEna &= ~pollIRQMask;
+        }
+
+        // IRQ PCIe enable flag should not be changed. Possible RACER here
+        shadowIRQEna |= (IRQ_PCIee & (READ32(base, IRQEnable)));
+
+        WRITE32(base, IRQEnable, shadowIRQEna);
+    }
+
+    // not with interruptLock, which may disable interrupts
+    if(busyPoll && !busyPoller.get()) {
+        busyPoller.reset(new IRQPoller(&EVRMRM::poll_fifo, (void*)this, busyPollOpts, "EVRPOLL", &sched_poll));
+    }
+}
 
-    WRITE32(base, IRQEnable, shadowIRQEna);
+void
+EVRMRM::busyPollSetup(int cpu, int priority, double spin)
+{
+    if(priority<0 || priority>99)
+        throw std::invalid_argument("SCHED_FIFO priority must be in range [0, 99]");
+
+    {
+        interruptLock I;
+        if(shadowIRQEna&IRQ_Enable)
+            throw std::logic_error("Busy poll must be configured before iocInit");
+    }
+
+    // the polling thread applies these when it starts
+    if(cpu>=0)
+        sched_poll.setCPUs(SB()<<cpu);
+    sched_poll.setPriority(priority);
+
+    busyPollOpts.spin = spin;
+    // when idle, poll no less often than the FIFO interrupt would be serviced under load
+    busyPollOpts.period = std::max(epicsThreadSleepQuantum(), 1e-4);
+    busyPoll = true;
 }
 
 void
@@ -1280,13 +1653,18 @@ EVRMRM::isr(EVRMRM *evr, bool pci)
         scanIoRequest(evr->IRQrxError);
 
         evr->shadowIRQEna &= ~IRQ_RXErr;
-        callbackRequest(&evr->poll_link_cb);
+        mrf::laneRequest(&evr->poll_link_cb);
     }
     if(active&IRQ_BufFull){
         // Silence interrupt
         BITSET(NAT,32,evr->base, DataBufCtrl, DataBufCtrl_stop);
 
-        callbackRequest(&evr->data_rx_cb);
+        mrf::laneRequest(&evr->data_rx_cb);
+    }
+    if(active&IRQ_SegDBuf){
+        // re-enabled by seg_rx(), so that updates are coalesced while it runs
+        evr->shadowIRQEna &= ~IRQ_SegDBuf;
+        mrf::laneRequest(&evr->seg_rx_cb);
     }
     if(active&IRQ_HWMapped){
         evr->shadowIRQEna &= ~IRQ_HWMapped;
@@ -1295,6 +1673,8 @@ EVRMRM::isr(EVRMRM *evr, bool pci)
     if(active&IRQ_Event){
         //FIFO not-empty
         evr->shadowIRQEna &= ~IRQ_Event;
+        if(!evr->latencyEna || !mrfLocalMonotonic(&evr->lat_isr))
+            evr->lat_isr = 0u;
         int wakeup=0;
         evr->drain_fifo_wakeup.trySend(&wakeup, sizeof(wakeup));
     }
@@ -1304,6 +1684,8 @@ EVRMRM::isr(EVRMRM *evr, bool pci)
     }
     if(active&IRQ_FIFOFull){
         evr->shadowIRQEna &= ~IRQ_FIFOFull;
+        if(!evr->latencyEna || !mrfLocalMonotonic(&evr->lat_isr))
+            evr->lat_isr = 0u;
         int wakeup=0;
         evr->drain_fifo_wakeup.trySend(&wakeup, sizeof(wakeup));
 
@@ -1320,29 +1702,48 @@ EVRMRM::isr(EVRMRM *evr, bool pci)
     // IRQ PCIe enable flag should not be changed. Possible RACER here
     evr->shadowIRQEna |= (IRQ_PCIee & (READ32(evr->base, IRQEnable)));
 
-    WRITE32(evr->base, IRQFlag, flags);
+    // leave FIFOFull for poll_fifo() to see
+    WRITE32(evr->base, IRQFlag, flags&~evr->pollIRQMask);
     WRITE32(evr->base, IRQEnable, evr->shadowIRQEna);
     // Ensure IRQFlags is written before returning.
     evrMrmIsrFlagsTrashCan=READ32(evr->base, IRQFlag);
 }
 
-// Caller must hold evrLock
 static
 void
-eventInvoke(eventCode& event)
+eventNotify(eventCode& event)
 {
-#ifdef HAVE_PARALLEL_CB
-    // bit mask of priorities for which scans have been queued
-    unsigned prio_queued =
-#endif
-    scanIoRequest(event.occured);
-
     for(eventCode::notifiees_t::const_iterator it=event.notifiees.begin();
         it!=event.notifiees.end();
         ++it)
     {
         (*it->first)(it->second, event.code);
     }
+}
+
+// Caller must hold dispatchLock.
+// Only queues scans.  Notifiees (eg. seconds_tick()) must see each FIFO entry
+// exactly once, so are run by dispatch_one() whether or not this is called.
+static
+void
+eventInvoke(eventCode& event)
+{
+#ifdef HAVE_SCANIO_IMMEDIATE
+    // When mrfioc2 callback lanes are in use, scan from the lane for this code.
+    // lane_invoke() can't complete before we release dispatchLock.
+    mrf::CallbackLanes *lanes = mrf::CallbackLanes::active();
+    if(lanes && lanes->request(&event.lane_cb, event.code)) {
+        event.waitingfor=1;
+        return;
+    }
+    // no lanes, or lane full.  Use callback queues
+#endif
+
+#ifdef HAVE_PARALLEL_CB
+    // bit mask of priorities for which scans have been queued
+    unsigned prio_queued =
+#endif
+    scanIoRequest(event.occured);
 
     event.waitingfor=0; // assume caller handles waitingfor>0
     for(unsigned p=0; p<NUM_CALLBACK_PRIORITIES; p++) {
@@ -1356,133 +1757,48 @@ eventInvoke(eventCode& event)
     }
 }
 
+/* Moves entries from the hardware FIFO into fifo_ring.
+ * Does not hold evrLock while doing so.
+ * Processing is done by dispatch_fifo().
+ */
 void
 EVRMRM::drain_fifo()
 {
-    size_t i;
     printf("EVR FIFO task start\n");
+    sched_fifo.attach();
 
-    SCOPED_LOCK2(evrLock, guard);
+    {
+        SCOPED_LOCK(evrLock);
+        // Reset fifo when IOC starts
+        BITSET(NAT,32, base, Control, Control_fiforst);
+    }
 
-    // Reset fifo when IOC starts
-    BITSET(NAT,32, base, Control, Control_fiforst);
+    std::fill(pace_codecnt, pace_codecnt+NELEMENTS(pace_codecnt), 0u);
 
     while(true) {
         int msg, err;
 
-        guard.unlock();
-
         err=drain_fifo_wakeup.receive(&msg, sizeof(msg));
 
         if (err<0) {
             errlogPrintf("FIFO wakeup error %d\n",err);
             epicsThreadSleep(0.1); // avoid message flood
-            guard.lock();
             continue;
 
         } else if(msg==1) {
             // Request thread stop
-            guard.lock();
             break;
         }
 
-        guard.lock();
-
-        count_fifo_loops++;
-
-        epicsUInt32 status;
-
-        // Bound the number of events taken from the FIFO
-        // at one time.
-        for(i=0; i<512; i++) {
-
-            status=READ32(base, IRQFlag);
-            if (!(status&IRQ_Event))
-                break;
-            if (status&IRQ_RXErr)
-                break;
-
-            epicsUInt32 code=READ32(base, EvtFIFOCode);
-            if (!code)
-                break;
-
-            if (code>NELEMENTS(events)) {
-                // BUG: we get occasional corrupt VME reads of this register
-                // Fixed in firmware.  Feb 2011
-                epicsUInt32 code2=READ32(base, EvtFIFOCode);
-                if (code2>NELEMENTS(events)) {
-                    printf("Really weird event 0x%08x 0x%08x\n", code, code2);
-                    break;
-                } else
-                    code=code2;
-            }
-            code &= 0xff; // (in)santity check
-
-            count_fifo_events++;
-
-            eventCode& evt = events[code];
-
-            // cache of last time
-            evt.last_sec=READ32(base, EvtFIFOSec);
-            evt.last_evt=READ32(base, EvtFIFOEvt);
-
-            // update any timestamp buffers
-            for(eventCode::tbufs_t::const_iterator it(evt.tbufs.begin()), end(evt.tbufs.end());
-                it!=end; ++it)
-            {
-                EVRMRMTSBuffer* tbuf = *it;
-
-                if(tbuf->timeEvt==code) {
-                    EVRMRMTSBuffer::ebuf_t& buf = tbuf->ebufs[tbuf->active];
-                    // add code to buffer
-                    if(buf.pos < buf.buf.size()) {
-                        // append raw time to buffer
-                        buf.buf[buf.pos].secPastEpoch = evt.last_sec;
-                        buf.buf[buf.pos].nsec = evt.last_evt;
-                        buf.pos++;
-
-                    } else {
-                        buf.drop = true;
-                        tbuf->dropped++;
-                    }
-                }
-
-                if(tbuf->flushEvt==code) {
-                    // flush
-                    EVRMRMTSBuffer::ebuf_t& active = tbuf->ebufs[tbuf->active];
-                    active.flushtime.secPastEpoch = evt.last_sec;
-                    active.flushtime.nsec = evt.last_evt;
-
-                    active.ok &= convertTS(&active.flushtime);
-
-                    tbuf->doFlush();
-                }
-            }
-
-            if (evt.again) {
-                // ignore extra events in buffer.
-            } else if (evt.waitingfor>0) {
-                // already queued, but received again before all
-                // callbacks finished.  Un-map event until complete
-                evt.again=true;
-                specialSetMap(code, ActionFIFOSave, false);
-                count_FIFO_sw_overrate++;
-            } else {
-                // needs to be queued
-                eventInvoke(evt);
-            }
+        // FIFO interrupts are disabled until the end of this loop, so lat_isr is stable
+        epicsUInt64 tisr = lat_isr, tdrain = 0u;
+        if(tisr && !mrfLocalMonotonic(&tdrain))
+            tisr = 0u;
 
-        }
+        size_t n = drain_once(tisr, tdrain);
 
-        if (status&IRQ_FIFOFull) {
-            count_FIFO_overflow++;
-        }
-
-        if (status&(IRQ_FIFOFull|IRQ_RXErr)) {
-            // clear fifo if link lost or buffer overflow
-            BITSET(NAT,32, base, Control, Control_fiforst);
-            printf("EVR(IRQ_FIFOFull|IRQ_RXErr): Reset Event FIFO (status=0x%08x)\n", status);
-        }
+        if (!fifo_ring.empty())
+            dispatch_fifo_wakeup.signal();
 
         int iflags=epicsInterruptLock();
 
@@ -1495,20 +1811,411 @@ EVRMRM::drain_fifo()
 
         epicsInterruptUnlock(iflags);
 
-        // wait a fixed interval before checking again
+        // Back off when the event rate is too high.
         // Prevents this thread from starving others
         // if a high frequency event is accidentally
         // mapped into the FIFO.
-        if(mrmEvrFIFOPeriod>0.0) {
-            guard.unlock();
-            epicsThreadSleep(mrmEvrFIFOPeriod);
-            guard.lock();
+        double sleep = paceSleep(n);
+        if(sleep>0.0) {
+            epicsThreadSleep(sleep);
         }
     }
 
+    sched_fifo.detach();
     printf("FIFO task exiting\n");
 }
 
+size_t
+EVRMRM::drain_once(epicsUInt64 tisr, epicsUInt64 tdrain)
+{
+    size_t i;
+    epicsUInt32 status;
+
+    count_fifo_loops++;
+
+    // Bound the number of events taken from the FIFO
+    // at one time.
+    for(i=0; i<512; i++) {
+
+        status=READ32(base, IRQFlag);
+        if (!(status&IRQ_Event))
+            break;
+        if (status&IRQ_RXErr)
+            break;
+
+        // dispatch is falling behind.  leave the remainder in the hardware FIFO
+        if (fifo_ring.size()>=fifo_ring.capacity())
+            break;
+
+        epicsUInt32 code=READ32(base, EvtFIFOCode);
+        if (!code)
+            break;
+
+        if (code>NELEMENTS(events)) {
+            // BUG: we get occasional corrupt VME reads of this register
+            // Fixed in firmware.  Feb 2011
+            epicsUInt32 code2=READ32(base, EvtFIFOCode);
+            if (code2>NELEMENTS(events)) {
+                printf("Really weird event 0x%08x 0x%08x\n", code, code2);
+                break;
+            } else
+                code=code2;
+        }
+        code &= 0xff; // (in)santity check
+
+        count_fifo_events++;
+        pace_codecnt[code]++;
+
+        FIFOEntry ent;
+        ent.code = code;
+        ent.sec  = READ32(base, EvtFIFOSec);
+        ent.evt  = READ32(base, EvtFIFOEvt);
+        ent.tisr = tisr;
+        ent.tdrain = tdrain;
+
+        fifo_ring.push(ent);
+    }
+
+    if (status&IRQ_FIFOFull) {
+        count_FIFO_overflow++;
+    }
+
+    if (status&(IRQ_FIFOFull|IRQ_RXErr)) {
+        SCOPED_LOCK(evrLock);
+        // clear fifo if link lost or buffer overflow
+        BITSET(NAT,32, base, Control, Control_fiforst);
+        printf("EVR(IRQ_FIFOFull|IRQ_RXErr): Reset Event FIFO (status=0x%08x)\n", status);
+    }
+
+    return i;
+}
+
+/* Busy poll mode replacement for isr(), drain_fifo() and dispatch_fifo().
+ * Runs in the IRQPoller thread, which is the only producer and consumer of fifo_ring.
+ * IRQ_Event and IRQ_FIFOFull interrupts are not enabled.
+ */
+int
+EVRMRM::poll_fifo(void *arg)
+{
+    EVRMRM *evr=static_cast<EVRMRM*>(arg);
+
+    epicsUInt32 flags=READ32(evr->base, IRQFlag);
+    if(!(flags&(IRQ_Event|IRQ_FIFOFull)))
+        return 0;
+
+    // latency stages IRQ and Dispatch both start when the FIFO is seen not-empty
+    epicsUInt64 tpoll = 0u;
+    if(!evr->latencyEna || !mrfLocalMonotonic(&tpoll))
+        tpoll = 0u;
+
+    size_t n = evr->drain_once(tpoll, tpoll);
+
+    if(flags&IRQ_FIFOFull) {
+        WRITE32(evr->base, IRQFlag, IRQ_FIFOFull);
+        scanIoRequest(evr->IRQfifofull);
+    }
+
+    FIFOEntry ent;
+    while(evr->fifo_ring.pop(ent)) {
+        evr->dispatch_one(ent);
+    }
+
+    double sleep = evr->paceSleep(n);
+    if(sleep>0.0) {
+        epicsThreadSleep(sleep);
+    }
+
+    return 1;
+}
+
+/* How long drain_fifo() sleeps after taking nevents from the FIFO.
+ * No sleep while the recent event rate is within budget.
+ * Under flood, back off exponentially up to mrmEvrFIFOPeriod.
+ * Recover by halving once the rate falls below half of the budget.
+ */
+double
+EVRMRM::paceSleep(size_t nevents)
+{
+    const double maxSleep = mrmEvrFIFOPeriod;
+    if(maxSleep<=0.0)
+        return 0.0; // disabled
+
+    epicsUInt64 now;
+    if(!mrfLocalMonotonic(&now))
+        return maxSleep; // can't measure rate.  Always sleep
+
+    pace_count += nevents;
+
+    if(!pace_last) {
+        pace_last = pace_codelast = now;
+        return pace_sleep;
+    }
+
+    // Re-evaluate every 100ms, or sooner if the budget for that period is exceeded
+    const double dT = (now-pace_last)*1e-9;
+    if(dT<=0.0 || (dT<0.1 && pace_count<pace_limit*0.1))
+        return pace_sleep;
+
+    const double rate = pace_count/dT;
+    pace_count = 0u;
+    pace_last = now;
+
+    const double minSleep = std::max(epicsThreadSleepQuantum(), 1e-5);
+    if(rate>pace_limit) {
+        pace_sleep = std::min(std::max(2.0*pace_sleep, minSleep), maxSleep);
+    } else if(rate<0.5*pace_limit) {
+        pace_sleep *= 0.5;
+        if(pace_sleep<minSleep)
+            pace_sleep = 0.0;
+    }
+
+    SCOPED_LOCK(evrLock);
+
+    pace_limit = pace_budget;
+    pace_rate = rate;
+    pace_backoff = pace_sleep;
+
+    const double dTcode = (now-pace_codelast)*1e-9;
+    if(dTcode>=1.0) {
+        pace_codelast = now;
+        pace_topcode = 0u;
+        pace_toprate = 0.0;
+        for(size_t code=0; code<NELEMENTS(pace_codecnt); code++) {
+            pace_coderate[code] = pace_codecnt[code]/dTcode;
+            pace_codecnt[code] = 0u;
+            if(pace_coderate[code]>pace_toprate) {
+                pace_topcode = code;
+                pace_toprate = pace_coderate[code];
+            }
+        }
+    }
+
+    return pace_sleep;
+}
+
+double
+EVRMRM::FIFORateBudget() const
+{
+    SCOPED_LOCK(evrLock);
+    return pace_budget;
+}
+
+void
+EVRMRM::FIFORateBudgetSet(double v)
+{
+    if(!(v>0.0))
+        throw std::invalid_argument("FIFO rate budget must be positive");
+    SCOPED_LOCK(evrLock);
+    pace_budget = v;
+}
+
+double
+EVRMRM::FIFORate() const
+{
+    SCOPED_LOCK(evrLock);
+    return pace_rate;
+}
+
+double
+EVRMRM::FIFOBackoff() const
+{
+    SCOPED_LOCK(evrLock);
+    return pace_backoff;
+}
+
+epicsUInt32
+EVRMRM::FIFOTopCode() const
+{
+    SCOPED_LOCK(evrLock);
+    return pace_topcode;
+}
+
+double
+EVRMRM::FIFOTopRate() const
+{
+    SCOPED_LOCK(evrLock);
+    return pace_toprate;
+}
+
+epicsUInt32
+EVRMRM::FIFOCodeRates(double *arr, epicsUInt32 count) const
+{
+    SCOPED_LOCK(evrLock);
+    count = std::min(count, epicsUInt32(pace_coderate.size()));
+    std::copy(pace_coderate.begin(), pace_coderate.begin()+count, arr);
+    return count;
+}
+
+void
+EVRMRM::dispatch_fifo()
+{
+    printf("EVR FIFO dispatch task start\n");
+    sched_dispatch.attach();
+
+    while(!epicsAtomicGetIntT(&dispatch_fifo_stop)) {
+        FIFOEntry ent;
+
+        dispatch_fifo_wakeup.wait();
+
+        while(fifo_ring.pop(ent)) {
+            dispatch_one(ent);
+        }
+    }
+
+    sched_dispatch.detach();
+    printf("FIFO dispatch task exiting\n");
+}
+
+void
+EVRMRM::dispatch_one(const FIFOEntry& ent)
+{
+    const epicsUInt32 code = ent.code;
+    eventCode& evt = events[code];
+
+    // cache of last time
+    eventCode::lastTime_t last;
+    last.time.secPastEpoch = ent.sec;
+    last.time.nsec = ent.evt;
+    {
+        SCOPED_LOCK(evrLock);
+        // avoid complaints about bad times until valid
+        last.ok = timestampValid>=TSValidThreshold && convertTS(&last.time);
+    }
+    evt.last.store(last);
+
+    SCOPED_LOCK(dispatchLock);
+
+    epicsUInt64 tnow = 0u;
+    if(ent.tisr && mrfLocalMonotonic(&tnow)) {
+        latencyRecord(code, LatIRQ, ent.tisr, ent.tdrain);
+        latencyRecord(code, LatDispatch, ent.tdrain, tnow);
+    } else {
+        tnow = 0u;
+    }
+
+    // update any timestamp buffers
+    for(eventCode::tbufs_t::const_iterator it(evt.tbufs.begin()), end(evt.tbufs.end());
+        it!=end; ++it)
+    {
+        EVRMRMTSBuffer* tbuf = *it;
+
+        if(tbuf->timeEvt==code) {
+            EVRMRMTSBuffer::ebuf_t& buf = *tbuf->ebufs[tbuf->active];
+
+            if(buf.stats.enabled)
+                buf.stats.add(epicsInt64(ent.sec)*1000000000 + epicsInt64(tickScale().toNS(ent.evt)));
+
+            // add code to buffer
+            if(buf.pos < buf.buf.size()) {
+                // append raw time to buffer
+                buf.buf[buf.pos].secPastEpoch = ent.sec;
+                buf.buf[buf.pos].nsec = ent.evt;
+                buf.pos++;
+
+            } else {
+                buf.drop = true;
+                tbuf->dropped++;
+            }
+        }
+
+        if(tbuf->flushEvt==code) {
+            // flush
+            EVRMRMTSBuffer::ebuf_t& active = *tbuf->ebufs[tbuf->active];
+            active.flushtime = last.time;
+            active.ok &= last.ok;
+
+            tbuf->doFlush();
+        }
+    }
+
+    // software rate limit of scans.  Notifiees see every occurrence.
+    bool scan = true;
+    if(evt.every>1u) {
+        if(++evt.everycnt < evt.every)
+            scan = false;
+        else
+            evt.everycnt = 0u;
+    }
+
+    epicsUInt64 trun = 0u;
+    if(scan && evt.minPeriod && mrfLocalMonotonic(&trun)) {
+        if(evt.lastRun && trun-evt.lastRun < evt.minPeriod)
+            scan = false;
+    }
+
+    if(!scan) {
+        evt.decimated++;
+    } else if (evt.waitingfor>0) {
+        // already queued, but received again before all
+        // callbacks finished.
+        evt.overrate++;
+        count_FIFO_sw_overrate++;
+        if(evt.coalesce)
+            evt.again = true;
+    } else {
+        // needs to be queued
+        if(trun)
+            evt.lastRun = trun;
+        evt.t_isr = ent.tisr;
+        evt.t_invoke = tnow;
+        eventInvoke(evt);
+    }
+
+    eventNotify(evt);
+}
+
+void
+EVRMRM::eventPolicySet(epicsUInt32 event, epicsUInt32 every, double maxRate, bool coalesce)
+{
+    if (event==0 || event>255)
+        throw std::out_of_range("Invalid event number");
+    if(!(maxRate>=0.0))
+        throw std::invalid_argument("Max rate must be >=0");
+
+    eventCode& evt = events[event];
+
+    SCOPED_LOCK(dispatchLock);
+    evt.every = every;
+    evt.everycnt = 0u;
+    evt.minPeriod = maxRate>0.0 ? epicsUInt64(1e9/maxRate) : 0u;
+    evt.lastRun = 0u;
+    evt.coalesce = coalesce;
+    if(!coalesce)
+        evt.again = false;
+}
+
+void
+EVRMRM::eventPolicy(epicsUInt32 event, epicsUInt32 *every, double *maxRate, bool *coalesce) const
+{
+    if (event==0 || event>255)
+        throw std::out_of_range("Invalid event number");
+
+    const eventCode& evt = events[event];
+
+    SCOPED_LOCK(dispatchLock);
+    *every = evt.every;
+    *maxRate = evt.minPeriod ? 1e9/evt.minPeriod : 0.0;
+    *coalesce = evt.coalesce;
+}
+
+epicsUInt32
+EVRMRM::FIFOOverRateCodes(epicsUInt32 *arr, epicsUInt32 count) const
+{
+    count = std::min(count, epicsUInt32(NELEMENTS(events)));
+    for(epicsUInt32 i=0; i<count; i++)
+        arr[i] = events[i].overrate;
+    return count;
+}
+
+epicsUInt32
+EVRMRM::FIFODecimatedCodes(epicsUInt32 *arr, epicsUInt32 count) const
+{
+    count = std::min(count, epicsUInt32(NELEMENTS(events)));
+    for(epicsUInt32 i=0; i<count; i++)
+        arr[i] = events[i].decimated;
+    return count;
+}
+
 void
 EVRMRM::sentinel_done(CALLBACK* cb)
 {
@@ -1517,24 +2224,48 @@ try {
     callbackGetUser(vptr,cb);
     eventCode *sent=static_cast<eventCode*>(vptr);
 
-    SCOPED_LOCK2(sent->owner->evrLock, guard);
+    SCOPED_LOCK2(sent->owner->dispatchLock, guard);
 
     // Is this the last callback queue?
     if (--sent->waitingfor)
         return;
 
-    bool run=sent->again;
-    sent->again=false;
-
-    // Re-enable mapping if disabled
-    if (run && sent->interested) {
-        sent->owner->specialSetMap(sent->code, ActionFIFOSave, true);
+    epicsUInt64 tnow;
+    if(sent->t_invoke && mrfLocalMonotonic(&tnow)) {
+        sent->owner->latencyRecord(sent->code, LatCallback, sent->t_invoke, tnow);
+        sent->owner->latencyRecord(sent->code, LatTotal, sent->t_isr, tnow);
+    }
+    sent->t_invoke = 0u;
+
+    // scan once more for occurrences coalesced while busy.
+    // Notifiees already ran for those occurrences.
+    if (sent->again) {
+        sent->again=false;
+        sent->t_isr = 0u;
+        eventInvoke(*sent);
     }
 } catch(std::exception& e) {
     epicsPrintf("exception in sentinel_done callback: %s\n", e.what());
 }
 }
 
+/* Run I/O Intr scans of an event from an mrfioc2 callback lane,
+ * then complete as sentinel_done() would for the callback queues.
+ */
+void
+EVRMRM::lane_invoke(CALLBACK* cb)
+{
+#ifdef HAVE_SCANIO_IMMEDIATE
+    void *vptr;
+    callbackGetUser(vptr,cb);
+    eventCode *sent=static_cast<eventCode*>(vptr);
+
+    for(int p=0; p<NUM_CALLBACK_PRIORITIES; p++)
+        scanIoImmediate(sent->occured, p);
+#endif
+    sentinel_done(cb);
+}
+
 void
 EVRMRM::poll_link(CALLBACK* cb)
 {
@@ -1572,6 +2303,27 @@ try {
 }
 }
 
+void
+EVRMRM::seg_rx(CALLBACK* cb)
+{
+try {
+    void *vptr;
+    callbackGetUser(vptr,cb);
+    EVRMRM *evr=static_cast<EVRMRM*>(vptr);
+
+    evr->bufrx.drainSegments();
+
+    int iflags=epicsInterruptLock();
+    evr->shadowIRQEna |= IRQ_SegDBuf;
+    // IRQ PCIe enable flag should not be changed. Possible RACER here
+    evr->shadowIRQEna |= (IRQ_PCIee & (READ32(evr->base, IRQEnable)));
+    WRITE32(evr->base, IRQEnable, evr->shadowIRQEna);
+    epicsInterruptUnlock(iflags);
+} catch(std::exception& e) {
+    epicsPrintf("exception in seg_rx callback: %s\n", e.what());
+}
+}
+
 static
 void send_timestamp(CALLBACK *cb)
 {
@@ -1648,12 +2400,18 @@ EVRMRM::seconds_tick(void *raw, epicsUInt32)
         }
     }
 
+    // refresh anchor for interpolation of current time
+    if(evrMrmTimeInterp && evr->timestampValid>=TSValidThreshold) {
+        epicsTimeStamp ts;
+        (void)evr->latchTime(&ts);
+    }
+
     if(evr->timeSrcMode==External) {
         // avoid lock ordering problem with EVR lock and generalTime locks
         callbackSetCallback(&send_timestamp, &evr->timeSrc_cb);
         callbackSetUser(evr, &evr->timeSrc_cb);
         callbackSetPriority(priorityMedium, &evr->timeSrc_cb);
-        callbackRequest(&evr->timeSrc_cb);
+        mrf::laneRequest(&evr->timeSrc_cb);
     }
 }
 
@@ -1665,7 +2423,7 @@ EVRMRM::getUtag(const epicsUInt32 event) const {
     else if(event>255) throw std::runtime_error("Event code out of range");
     SCOPED_LOCK(evrLock);
 
-    return events[event].utag;
+    return eventConfigs[event].utag;
 }
 
 // Set UTAG value for specific event
@@ -1676,7 +2434,7 @@ EVRMRM::setUtag(epicsUTag tag, const epicsUInt32 event) {
     SCOPED_LOCK(evrLock);
 
     // set UTAG value to particular event
-    events[event].utag = tag;
+    eventConfigs[event].utag = tag;
     return;
 }
 #endif
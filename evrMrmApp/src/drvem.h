@@ -26,9 +26,19 @@
 #include <epicsTime.h>
 #include <epicsThread.h>
 #include <epicsMessageQueue.h>
+#include <epicsEvent.h>
 #include <callback.h>
 #include <epicsMutex.h>
 
+#include "mrf/spscring.h"
+#include "mrf/seqlock.h"
+#include "mrf/smallvector.h"
+#include "mrf/pollirq.h"
+#include "mrf/threadsched.h"
+#include "mrf/cblanes.h"
+
+#include "tickscale.h"
+
 #include "drvemInput.h"
 #include "drvemOutput.h"
 #include "drvemPrescaler.h"
@@ -48,43 +58,81 @@
 
 class EVRMRM;
 
+/* State of one event code used by the FIFO dispatch thread for each received event.
+ * Ordered so that the common case touches only the first cache line or two.
+ * Configuration only state is in eventCodeConfig.
+ */
 struct eventCode {
     epicsUInt8 code; // constant
-    EVRMRM* owner;
-
-    // For efficiency events will only
-    // be mapped into the FIFO when this
-    // counter is non-zero.
-    size_t interested;
 
-    epicsUInt32 last_sec;
-    epicsUInt32 last_evt;
+    // Guarded by dispatchLock
+    bool again; // coalesced while callbacks pending.  Scan again when complete
+    size_t waitingfor;
 
-    typedef std::set<EVRMRMTSBuffer*> tbufs_t;
+    // Software rate limiting policy.  Guarded by dispatchLock
+    epicsUInt32 every;     // run callbacks for every Nth occurrence.  0 or 1 for all
+    epicsUInt32 everycnt;
+    epicsUInt64 minPeriod; // minimum ns between runs.  0 for no limit
+    epicsUInt64 lastRun;   // local monotonic ns
+    bool coalesce;         // when received while callbacks pending, run once more after completion
+    // Written with dispatchLock held.  Read without
+    epicsUInt32 overrate;  // received while callbacks pending
+    epicsUInt32 decimated; // skipped by every or minPeriod
+
+    // Guarded by dispatchLock
+    // Few subscribers per code, so these are usually stored inline.
+    typedef mrf::SmallVector<EVRMRMTSBuffer*, 2> tbufs_t;
     tbufs_t tbufs;
 
+    typedef mrf::SmallVector<std::pair<EVR::eventCallback,void*>, 2> notifiees_t;
+    notifiees_t notifiees;
+
     IOSCANPVT occured;
 
-    typedef std::list<std::pair<EVR::eventCallback,void*> > notifiees_t;
-    notifiees_t notifiees;
+    // Time of last occurance, already converted.
+    // Written by FIFO dispatch thread.  Read without locking.
+    struct lastTime_t {
+        epicsTimeStamp time;
+        bool ok; // false until received with valid time
+    };
+    mrf::SeqLock<lastTime_t> last;
 
+    EVRMRM* owner;
+
+    // Guarded by dispatchLock
     CALLBACK done_cb;
-    size_t waitingfor;
-    bool again;
+    // Queued to a mrf::CallbackLane when lanes are used
+    CALLBACK lane_cb;
+    // local monotonic times (ns) for latency instrumentation.  0 if not measured
+    epicsUInt64 t_isr, t_invoke;
+
+    eventCode():code(0), again(false), waitingfor(0)
+            ,every(0u), everycnt(0u), minPeriod(0u), lastRun(0u), coalesce(false)
+            ,overrate(0u), decimated(0u)
+            ,owner(0), t_isr(0u), t_invoke(0u)
+    {
+        scanIoInit(&occured);
+        // done_cb - initialized in EVRMRM::EVRMRM()
+    }
+};
+
+// Per event code configuration.  Guarded by evrLock
+struct eventCodeConfig {
+    // For efficiency events will only
+    // be mapped into the FIFO when this
+    // counter is non-zero.
+    // May be read without locking.
+    size_t interested;
 
     // UTAG associated to event
 #ifdef DBR_UTAG
     epicsUTag utag;
 #endif
-    eventCode():owner(0), interested(0), last_sec(0)
-            ,last_evt(0), waitingfor(0), again(false)
+    eventCodeConfig() :interested(0)
 #ifdef DBR_UTAG
             ,utag(0)
 #endif
-    {
-        scanIoInit(&occured);
-        // done_cb - initialized in EVRMRM::EVRMRM()
-    }
+    {}
 };
 
 /**@brief Modular Register Map Event Receivers
@@ -103,6 +151,14 @@ public:
    */
     mutable epicsMutex evrLock;
 
+    /** @brief Guards event dispatch
+     *  Timestamp buffers, notifiee lists, and callback completion
+     *  tracking of eventCode.  Held by the FIFO dispatch thread
+     *  while running callbacks.
+     *  May be taken before evrLock, but never while holding evrLock.
+     */
+    mutable epicsMutex dispatchLock;
+
     struct Config {
         const char *model;
         size_t nPul; // number of pulsers
@@ -179,6 +235,8 @@ public:
         {SCOPED_LOCK(evrLock);return shadowSourceTS;}
     virtual double clockTS() const OVERRIDE FINAL;
     virtual void clockTSSet(double) OVERRIDE FINAL;
+    //! Tick to ns conversion for the current timestamp clock.  Does not lock.
+    TickScale tickScale() const { return tickscale.load(); }
     virtual bool interestedInEvent(epicsUInt32 event,bool set) OVERRIDE FINAL;
 
     virtual bool TimeStampValid() const OVERRIDE FINAL;
@@ -192,23 +250,104 @@ public:
 
     bool convertTS(epicsTimeStamp* ts);
 
+    //! Interpolation error measured at last hardware latch (ns)
+    double timeInterpErr() const;
+    //! Largest interpolation error measured (ns)
+    double timeInterpErrMax() const;
+
+    /** @name Event latency instrumentation
+     *
+     * log2 histograms of the time taken by each stage of event dispatch,
+     * per event code.  Bucket i counts latencies in [2**i, 2**(i+1)) ns.
+     * Last bucket includes all longer latencies.
+     */
+    //@{
+    enum latStage_t {
+        LatIRQ,      //!< isr() to drain_fifo() wakeup
+        LatDispatch, //!< drain_fifo() wakeup to dispatch of entry
+        LatCallback, //!< dispatch to sentinel_done()
+        LatTotal,    //!< isr() to sentinel_done()
+        LatNStages
+    };
+    enum {LatNBuckets=32};
+
+    bool latencyEnabled() const;
+    void latencyEnable(bool v);
+    //! Select event code shown by latency properties.  0 for all
+    epicsUInt32 latencyCode() const {return latCode;}
+    void latencyCodeSet(epicsUInt32 v);
+    void latencyReset();
+    //! Copy out LatNBuckets counts for one event code, or the sum of all codes for 0.  Lockless.
+    void latencyHist(epicsUInt32 code, latStage_t stage, epicsUInt32 *arr) const;
+
+    epicsUInt32 latencyIRQ(epicsUInt32 *arr, epicsUInt32 count) const;
+    epicsUInt32 latencyDispatch(epicsUInt32 *arr, epicsUInt32 count) const;
+    epicsUInt32 latencyCallback(epicsUInt32 *arr, epicsUInt32 count) const;
+    epicsUInt32 latencyTotal(epicsUInt32 *arr, epicsUInt32 count) const;
+    //@}
+
     virtual epicsUInt16 dbus() const OVERRIDE FINAL;
 
     virtual epicsUInt32 heartbeatTIMOCount() const OVERRIDE FINAL {return count_heartbeat;}
     virtual IOSCANPVT heartbeatTIMOOccured() const OVERRIDE FINAL {return IRQheartbeat;}
 
-    virtual epicsUInt32 FIFOFullCount() const OVERRIDE FINAL
-    {SCOPED_LOCK(evrLock);return count_FIFO_overflow;}
-    virtual epicsUInt32 FIFOOverRate() const OVERRIDE FINAL
-    {SCOPED_LOCK(evrLock);return count_FIFO_sw_overrate;}
+    virtual epicsUInt32 FIFOFullCount() const OVERRIDE FINAL {return count_FIFO_overflow;}
+    virtual epicsUInt32 FIFOOverRate() const OVERRIDE FINAL {return count_FIFO_sw_overrate;}
     virtual epicsUInt32 FIFOEvtCount() const OVERRIDE FINAL {return count_fifo_events;}
     virtual epicsUInt32 FIFOLoopCount() const OVERRIDE FINAL {return count_fifo_loops;}
+
+    //! Segmented data buffer counters, in segments
+    epicsUInt32 dbufSegUpdates() const {return bufrx.segUpdateCount();}
+    epicsUInt32 dbufSegOverflows() const {return bufrx.segOverflowCount();}
+    epicsUInt32 dbufSegErrors() const {return bufrx.segErrorCount();}
+
+    /** @brief Software rate limit for callbacks and I/O Intr scans of an event code.
+     *
+     * Timestamps, TS buffers and other internal actions still see every occurrence.
+     *
+     @param every Run for every Nth occurrence.  0 or 1 for all
+     @param maxRate Run at most this often (Hz).  0 for no limit
+     @param coalesce When an occurrence arrives before the callbacks of the previous have completed,
+                     scan I/O Intr records once more after completion.  Otherwise it is dropped.
+                     Internal actions (eg. timestamping) run once for each occurrence.
+     */
+    void eventPolicySet(epicsUInt32 event, epicsUInt32 every, double maxRate, bool coalesce);
+    void eventPolicy(epicsUInt32 event, epicsUInt32 *every, double *maxRate, bool *coalesce) const;
+    //! Per event code counts of occurrences received while callbacks were pending
+    epicsUInt32 FIFOOverRateCodes(epicsUInt32 *arr, epicsUInt32 count) const;
+    //! Per event code counts of occurrences skipped by policy
+    epicsUInt32 FIFODecimatedCodes(epicsUInt32 *arr, epicsUInt32 count) const;
+
+    //! FIFO event rate (events/sec) above which drain_fifo() backs off
+    double FIFORateBudget() const;
+    void FIFORateBudgetSet(double v);
+    //! Recent FIFO event rate (events/sec)
+    double FIFORate() const;
+    //! Current drain_fifo() sleep (sec)
+    double FIFOBackoff() const;
+    //! Event code with highest FIFO rate over the last second
+    epicsUInt32 FIFOTopCode() const;
+    double FIFOTopRate() const;
+    //! FIFO rate of each event code over the last second
+    epicsUInt32 FIFOCodeRates(double *arr, epicsUInt32 count) const;
 #ifdef DBR_UTAG
     virtual epicsUTag getUtag(const epicsUInt32 event) const OVERRIDE FINAL;
     virtual void setUtag(epicsUTag tag, const epicsUInt32 event) OVERRIDE FINAL;
 #endif
     void enableIRQ(void);
 
+    /** @brief Poll the event FIFO from a dedicated thread instead of using FIFO interrupts.
+     *
+     * Entries are dispatched from the polling thread, bypassing drain_fifo() and dispatch_fifo().
+     * Must be configured before iocInit.
+     *
+     @param cpu Pin polling thread to this CPU.  -1 for no pinning
+     @param priority SCHED_FIFO priority 1-99.  0 to use the EPICS thread priority
+     @param spin Keep polling for this long (sec) after the last event before sleeping.  <0 to never sleep
+     */
+    void busyPollSetup(int cpu, int priority, double spin);
+    bool busyPollEnabled() const {return busyPoll;}
+
     bool dcEnabled() const;
     void dcEnable(bool v);
 
@@ -243,6 +382,8 @@ public:
     static void isr_pci(void*);
     static void isr_vme(void*);
     static void isr_poll(void*);
+    //! For the IRQPoller thread which calls isr_poll()
+    mrf::ThreadSched& isrPollSched() { return sched_isrpoll; }
 #if defined(__linux__) || defined(_WIN32)
     const void *isrLinuxPvt;
 #endif
@@ -273,8 +414,8 @@ private:
 
     epicsUInt32 shadowIRQEna;
 
-    // Guarded by evrLock
-    epicsUInt32 count_FIFO_overflow;
+    // Set by FIFO thread
+    volatile epicsUInt32 count_FIFO_overflow;
 
     // scanIoRequest() from ISR or callback
     IOSCANPVT IRQmappedEvent; // Hardware mapped IRQ
@@ -308,20 +449,85 @@ private:
 
     mrf::auto_ptr<EvrSeqManager> seq;
 
+    // CPU affinity and priority of FIFO threads.  Before the threads themselves
+    mrf::ThreadSched sched_fifo, sched_dispatch, sched_poll, sched_isrpoll;
+
     // run when FIFO not-full IRQ is received
     void drain_fifo();
     epicsThreadRunableMethod<EVRMRM, &EVRMRM::drain_fifo> drain_fifo_method;
     epicsThread drain_fifo_task;
     epicsMessageQueue drain_fifo_wakeup;
-    static void sentinel_done(CALLBACK*);
 
-    epicsUInt32 count_FIFO_sw_overrate;
+    // Move entries from the hardware FIFO into fifo_ring.  Returns number moved.
+    size_t drain_once(epicsUInt64 tisr, epicsUInt64 tdrain);
+
+    // Busy poll mode.  Options and flag set before iocInit
+    IRQPoller::Options busyPollOpts;
+    bool busyPoll;
+    // IRQ flags left for the busy poll thread to acknowledge.  0 when not polling
+    epicsUInt32 pollIRQMask;
+    mrf::auto_ptr<IRQPoller> busyPoller;
+    static int poll_fifo(void*);
+
+    // Adaptive pacing of drain_fifo()
+    double paceSleep(size_t nevents);
+    // Only accessed by drain_fifo()
+    epicsUInt64 pace_last, pace_codelast;
+    size_t pace_count;
+    double pace_sleep, pace_limit;
+    epicsUInt32 pace_codecnt[256];
+    // Guarded by evrLock
+    double pace_budget, pace_rate, pace_backoff;
+    epicsUInt32 pace_topcode;
+    double pace_toprate;
+    std::vector<double> pace_coderate;
+
+    //! An entry read from the hardware event FIFO
+    struct FIFOEntry {
+        epicsUInt32 code, sec, evt;
+        // local monotonic times (ns) of interrupt and drain_fifo() wakeup.  0 if not measured
+        epicsUInt64 tisr, tdrain;
+    };
+    // Filled by drain_fifo(), emptied by dispatch_fifo().
+    // Both are done by poll_fifo() in busy poll mode.
+    mrf::SPSCRing<FIFOEntry> fifo_ring;
+
+    // run when drain_fifo() has added to fifo_ring
+    void dispatch_fifo();
+    void dispatch_one(const FIFOEntry& ent);
+    epicsThreadRunableMethod<EVRMRM, &EVRMRM::dispatch_fifo> dispatch_fifo_method;
+    epicsThread dispatch_fifo_task;
+    epicsEvent dispatch_fifo_wakeup;
+    int dispatch_fifo_stop;
+
+    static void sentinel_done(CALLBACK*);
+    static void lane_invoke(CALLBACK*);
+
+    // Latency instrumentation
+    int latencyEna;
+    epicsUInt32 latCode;
+    // time of last FIFO interrupt.  Written by isr(), read by drain_fifo()
+    epicsUInt64 lat_isr;
+    // [code][stage][bucket].  Written with dispatchLock held.  Read without.
+    std::vector<epicsUInt32> latHist;
+    // Set by latencyReset().  latHist is cleared by the next latencyRecord()
+    int latResetReq;
+    void latencyRecord(epicsUInt32 code, latStage_t stage, epicsUInt64 start, epicsUInt64 end);
+    epicsUInt32 latencyProp(latStage_t stage, epicsUInt32 *arr, epicsUInt32 count) const;
+
+    // Set by FIFO dispatch thread
+    volatile epicsUInt32 count_FIFO_sw_overrate;
 
     eventCode events[256];
+    eventCodeConfig eventConfigs[256];
 
     // Buffer received
     CALLBACK data_rx_cb;
 
+    // Segment(s) of segmented data buffer received
+    CALLBACK seg_rx_cb;
+    static void seg_rx(CALLBACK*);
+
     // Periodic callback to detect when link state goes from down to up
     CALLBACK poll_link_cb;
     static void poll_link(CALLBACK*);
@@ -343,11 +549,36 @@ private:
     epicsUInt32 shadowCounterPS;
     double eventClock; //!< Stored in Hz
 
-    epicsUInt32 timestampValid;
+    // Derived from clockTS().  Written with evrLock held.  Read without.
+    mrf::SeqLock<TickScale> tickscale;
+    void updateTickScale();
+
+    // Written with evrLock held.  May be read without.
+    int timestampValid;
     epicsUInt32 lastInvalidTimestamp;
     epicsUInt32 lastValidTimestamp;
     static void seconds_tick(void*, epicsUInt32);
 
+    bool latchTime(epicsTimeStamp *ts);
+
+    // Anchor for interpolating current time from a local monotonic clock.
+    // Written with evrLock held.  Read without locking.
+    struct timeAnchor_t {
+        epicsUInt64 mono;   // local time of latch (ns)
+        epicsTimeStamp evr; // EVR time of latch
+        epicsUInt64 rmono;  // start of rate estimate baseline
+        epicsTimeStamp revr;
+        double rate;        // EVR ns per local ns
+        bool rated;         // rate has been measured
+        bool ok;            // measured error is acceptable
+    };
+    mrf::SeqLock<timeAnchor_t> timeAnchor;
+    void anchorTime(const epicsTimeStamp& ts, epicsUInt64 t0, epicsUInt64 t1);
+    bool interpolateTime(epicsTimeStamp *ts) const;
+
+    // Guarded by evrLock
+    double interpErr, interpErrMax;
+
     // bit map of which event #'s are mapped
     // used as a safty check to avoid overloaded mappings
     epicsUInt32 _mapped[256];
@@ -119,6 +119,48 @@ static void mrmEvrLoopbackCallFunc(const iocshArgBuf *args)
     mrmEvrLoopback(args[0].sval,args[1].ival,args[2].ival);
 }
 
+static const iocshArg mrmEvrLatencyReportArg0 = { "name",iocshArgString};
+static const iocshArg mrmEvrLatencyReportArg1 = { "Event code (0 for all)",iocshArgInt};
+static const iocshArg * const mrmEvrLatencyReportArgs[2] =
+    {&mrmEvrLatencyReportArg0,&mrmEvrLatencyReportArg1};
+static const iocshFuncDef mrmEvrLatencyReportFuncDef =
+    {"mrmEvrLatencyReport",2,mrmEvrLatencyReportArgs};
+
+static void mrmEvrLatencyReportCallFunc(const iocshArgBuf *args)
+{
+    mrmEvrLatencyReport(args[0].sval,args[1].ival);
+}
+
+static const iocshArg mrmEvrEventPolicyArg0 = { "name",iocshArgString};
+static const iocshArg mrmEvrEventPolicyArg1 = { "Event code (0 to print)",iocshArgInt};
+static const iocshArg mrmEvrEventPolicyArg2 = { "Every Nth",iocshArgInt};
+static const iocshArg mrmEvrEventPolicyArg3 = { "Max rate (Hz)",iocshArgDouble};
+static const iocshArg mrmEvrEventPolicyArg4 = { "Coalesce 0 or 1",iocshArgInt};
+static const iocshArg * const mrmEvrEventPolicyArgs[5] =
+    {&mrmEvrEventPolicyArg0,&mrmEvrEventPolicyArg1,&mrmEvrEventPolicyArg2,
+     &mrmEvrEventPolicyArg3,&mrmEvrEventPolicyArg4};
+static const iocshFuncDef mrmEvrEventPolicyFuncDef =
+    {"mrmEvrEventPolicy",5,mrmEvrEventPolicyArgs};
+
+static void mrmEvrEventPolicyCallFunc(const iocshArgBuf *args)
+{
+    mrmEvrEventPolicy(args[0].sval,args[1].ival,args[2].ival,args[3].dval,args[4].ival);
+}
+
+static const iocshArg mrmEvrBusyPollArg0 = { "name",iocshArgString};
+static const iocshArg mrmEvrBusyPollArg1 = { "CPU (-1 for any)",iocshArgInt};
+static const iocshArg mrmEvrBusyPollArg2 = { "SCHED_FIFO priority (0 for default)",iocshArgInt};
+static const iocshArg mrmEvrBusyPollArg3 = { "Spin time (sec, <0 forever)",iocshArgDouble};
+static const iocshArg * const mrmEvrBusyPollArgs[4] =
+    {&mrmEvrBusyPollArg0,&mrmEvrBusyPollArg1,&mrmEvrBusyPollArg2,&mrmEvrBusyPollArg3};
+static const iocshFuncDef mrmEvrBusyPollFuncDef =
+    {"mrmEvrBusyPoll",4,mrmEvrBusyPollArgs};
+
+static void mrmEvrBusyPollCallFunc(const iocshArgBuf *args)
+{
+    mrmEvrBusyPoll(args[0].sval,args[1].ival,args[2].ival,args[3].dval);
+}
+
 static
 void mrmsetupreg()
 {
@@ -128,6 +170,9 @@ void mrmsetupreg()
     iocshRegister(&mrmEvrDumpMapFuncDef,mrmEvrDumpMapCallFunc);
     iocshRegister(&mrmEvrForwardFuncDef,mrmEvrForwardCallFunc);
     iocshRegister(&mrmEvrLoopbackFuncDef,mrmEvrLoopbackCallFunc);
+    iocshRegister(&mrmEvrLatencyReportFuncDef,mrmEvrLatencyReportCallFunc);
+    iocshRegister(&mrmEvrEventPolicyFuncDef,mrmEvrEventPolicyCallFunc);
+    iocshRegister(&mrmEvrBusyPollFuncDef,mrmEvrBusyPollCallFunc);
 }
 
 
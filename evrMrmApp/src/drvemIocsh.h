@@ -45,6 +45,12 @@ void epicsShareFunc
 mrmEvrForward(const char* id, const char* events_iocsh);
 void epicsShareFunc
 mrmEvrLoopback(const char* id, int rxLoopback, int txLoopback);
+void epicsShareFunc
+mrmEvrLatencyReport(const char* id, int evt);
+void epicsShareFunc
+mrmEvrEventPolicy(const char* id, int evt, int every, double maxRate, int coalesce);
+void epicsShareFunc
+mrmEvrBusyPoll(const char* id, int cpu, int priority, double spin);
 
 void epicsShareFunc
 mrmEvrInithooks(initHookState state);
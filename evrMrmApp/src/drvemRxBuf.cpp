@@ -12,7 +12,10 @@
 
 
 #include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
 #include <errlog.h>
+#include <cantProceed.h>
 
 #ifdef _WIN32
 	#include <Winsock2.h>
@@ -27,16 +30,24 @@
 #include <epicsExport.h>
 #include "evrRegMap.h"
 #include "drvemRxBuf.h"
+#include "mmiocopy.h"
 
 mrmBufRx::mrmBufRx(const std::string& n, volatile void *b,unsigned int qdepth, unsigned int bsize)
     :bufRxManager(n, qdepth, bsize)
     ,base((volatile unsigned char *)b)
+    ,wideRead(false)
+    ,segments(false)
+    ,segimage(NULL)
+    ,segUpdates(0u)
+    ,segOverflows(0u)
+    ,segErrors(0u)
 {
 }
 
 mrmBufRx::~mrmBufRx()
 {
     BITSET(NAT,32,base, DataBufCtrl, DataBufCtrl_stop);
+    free(segimage);
 }
 
 bool
@@ -117,9 +128,8 @@ try {
             }
 
             /* keep buffer in big endian mode (as sent by EVG) */
-            for(unsigned int i=0; i<rsize; i+=4) {
-                *(epicsUInt32*)(buf+i) = BE_READ32(self.base, DataRx(i));
-            }
+            mmioCopyBE32((epicsUInt32*)buf, self.base + U32_DataRx_base,
+                         (rsize+3u)/4u, self.wideRead);
             self.receive(buf, rsize);
         }
     }
@@ -129,3 +139,188 @@ try {
     epicsPrintf("exception in mrmBufRx::drainbuf callback: %s\n", e.what());
 }
 }
+
+void
+mrmBufRx::enableSegments()
+{
+    SCOPED_LOCK(segGuard);
+    if(segments)
+        return;
+    segimage = (epicsUInt32*)callocMustSucceed(SegCount, SegSize, "mrmBufRx segments");
+    seglisteners.resize(SegCount);
+    segments = true;
+}
+
+unsigned
+mrmBufRx::dataRxSegments() const
+{
+    // only set before iocInit
+    return segments ? SegCount : 0u;
+}
+
+unsigned
+mrmBufRx::dataRxSegmentSize() const
+{
+    return SegSize;
+}
+
+epicsUInt32
+mrmBufRx::segUpdateCount() const
+{
+    return segUpdates;
+}
+
+epicsUInt32
+mrmBufRx::segOverflowCount() const
+{
+    return segOverflows;
+}
+
+epicsUInt32
+mrmBufRx::segErrorCount() const
+{
+    return segErrors;
+}
+
+void
+mrmBufRx::dataRxAddReceiveSegment(unsigned first, unsigned count, dataBufComplete fn, void* arg)
+{
+    SCOPED_LOCK(segGuard);
+    if(!segments)
+        throw std::logic_error("Segmented data buffer not supported by this firmware");
+    if(count==0u || first>=unsigned(SegCount) || count>unsigned(SegCount)-first)
+        throw std::out_of_range("Segment range out of range");
+
+    seglistener l;
+    l.first = first;
+    l.count = count;
+    l.fn = fn;
+    l.fnarg = arg;
+
+    seglisteners_t& F = seglisteners[first];
+    for(seglisteners_t::const_iterator it(F.begin()), end(F.end()); it!=end; ++it) {
+        // Don't add duplicates
+        if(it->first==first && it->count==count && it->fn==fn && it->fnarg==arg)
+            return;
+    }
+
+    for(unsigned s=first; s<first+count; s++)
+        seglisteners[s].push_back(l);
+}
+
+void
+mrmBufRx::dataRxDeleteReceiveSegment(unsigned first, unsigned count, dataBufComplete fn, void* arg)
+{
+    SCOPED_LOCK(segGuard);
+    if(!segments || count==0u || first>=unsigned(SegCount) || count>unsigned(SegCount)-first)
+        return;
+
+    for(unsigned s=first; s<first+count; s++) {
+        seglisteners_t& L = seglisteners[s];
+        for(seglisteners_t::iterator it(L.begin()), end(L.end()); it!=end; ++it) {
+            if(it->first==first && it->count==count && it->fn==fn && it->fnarg==arg) {
+                L.erase(it);
+                break;
+            }
+        }
+    }
+}
+
+namespace {
+// segment 0 is the MSB of the first word
+inline bool segTest(const epicsUInt32 *bits, unsigned seg)
+{
+    return bits[seg/32u] & (0x80000000u>>(seg%32u));
+}
+
+// any bit set in [first, last)
+bool segAny(const epicsUInt32 *bits, unsigned first, unsigned last)
+{
+    for(unsigned s=first; s<last; s++) {
+        if(segTest(bits, s))
+            return true;
+    }
+    return false;
+}
+
+unsigned popcount(epicsUInt32 v)
+{
+    unsigned n=0u;
+    for(; v; v&=v-1u)
+        n++;
+    return n;
+}
+} // namespace
+
+void
+mrmBufRx::drainSegments()
+{
+    SCOPED_LOCK(segGuard);
+    if(!segments)
+        return;
+
+    // segments updated (or with errors) since last time
+    epicsUInt32 touched[SegWords], errs[SegWords];
+    bool any = false;
+
+    for(unsigned i=0; i<SegWords; i++) {
+        // clear flags before copying, so that an update during the copy is seen next time
+        epicsUInt32 rx   = READ32(base, SegRxFlag(i));
+        epicsUInt32 err  = READ32(base, SegRxChkErr(i));
+        epicsUInt32 ovfl = READ32(base, SegRxOvfl(i));
+        if(rx)   WRITE32(base, SegRxFlag(i), rx);
+        if(err)  WRITE32(base, SegRxChkErr(i), err);
+        if(ovfl) WRITE32(base, SegRxOvfl(i), ovfl);
+
+        touched[i] = rx|err;
+        errs[i] = err;
+        any |= touched[i]!=0u;
+
+        segUpdates   += popcount(rx&~err);
+        segOverflows += popcount(ovfl);
+        segErrors    += popcount(err);
+    }
+
+    if(!any)
+        return;
+
+    // copy each run of consecutive good segments, keeping big endian order (as sent by EVG)
+    for(unsigned s=0; s<unsigned(SegCount); ) {
+        if(!segTest(touched, s) || segTest(errs, s)) {
+            s++;
+            continue;
+        }
+        unsigned e=s+1u;
+        while(e<unsigned(SegCount) && segTest(touched, e) && !segTest(errs, e))
+            e++;
+        mmioCopyBE32(segimage + s*(SegSize/4u), base + U32_DataRx(s*SegSize),
+                     (e-s)*(SegSize/4u), wideRead);
+        s = e;
+    }
+
+    if(evrMrmSeqRxDebug>=2) {
+        errlogPrintf("buffer %s: segments %08x %08x %08x %08x\n", name().c_str(),
+                     (unsigned)touched[0], (unsigned)touched[1],
+                     (unsigned)touched[2], (unsigned)touched[3]);
+    }
+
+    for(unsigned s=0; s<unsigned(SegCount); s++) {
+        if(!segTest(touched, s))
+            continue;
+
+        const seglisteners_t& L = seglisteners[s];
+        for(seglisteners_t::const_iterator it(L.begin()), end(L.end()); it!=end; ++it) {
+            // a listener covering several segments is only called for the first updated one
+            if(segAny(touched, it->first, s))
+                continue;
+
+            const unsigned last = it->first + it->count;
+            if(segAny(errs, it->first, last)) {
+                (it->fn)(it->fnarg, 2, 0u, NULL);
+            } else {
+                (it->fn)(it->fnarg, 0, it->count*SegSize,
+                         (const epicsUInt8*)segimage + it->first*SegSize);
+            }
+        }
+    }
+}
@@ -11,7 +11,10 @@
 #ifndef DRVEMRXBUF_H
 #define DRVEMRXBUF_H
 
+#include <vector>
+
 #include <callback.h>
+#include <epicsMutex.h>
 
 #include "bufrxmgr.h"
 
@@ -30,8 +33,57 @@ public:
 
     static void drainbuf(CALLBACK*);
 
+    /* Read DataRx with wide loads, where supported (see mmiocopy.h).
+     * Only set when the bus is known to allow it.
+     */
+    void setWideRead(bool v) { wideRead = v; }
+
+    enum {
+        SegSize = 16,
+        SegCount = 128,
+        SegWords = SegCount/32, //!< words in each segment bitmap
+    };
+
+    //! Called once before iocInit if the firmware has the segmented data buffer
+    void enableSegments();
+
+    /* Copy only updated segments to segimage, then call their listeners.
+     * Called after an IRQ_SegDBuf interrupt.
+     */
+    void drainSegments();
+
+    epicsUInt32 segUpdateCount() const;
+    epicsUInt32 segOverflowCount() const;
+    epicsUInt32 segErrorCount() const;
+
+    virtual unsigned dataRxSegments() const OVERRIDE FINAL;
+    virtual unsigned dataRxSegmentSize() const OVERRIDE FINAL;
+    virtual void dataRxAddReceiveSegment(unsigned first, unsigned count, dataBufComplete fptr, void* arg=0) OVERRIDE FINAL;
+    virtual void dataRxDeleteReceiveSegment(unsigned first, unsigned count, dataBufComplete fptr, void* arg=0) OVERRIDE FINAL;
+
 protected:
     volatile unsigned char * const base;
+    bool wideRead;
+
+private:
+    // guards all segment members.  Held while listeners are called.
+    epicsMutex segGuard;
+    bool segments;
+
+    struct seglistener {
+        unsigned first, count;
+        dataBufComplete fn;
+        void *fnarg;
+    };
+    typedef std::vector<seglistener> seglisteners_t;
+    // indexed by segment number.  A listener is in the list of each segment it covers.
+    std::vector<seglisteners_t> seglisteners;
+
+    // last received contents of all segments, big endian.
+    epicsUInt32 *segimage;
+
+    // counters of segments.  Read without locking
+    epicsUInt32 segUpdates, segOverflows, segErrors;
 };
 
 #endif // DRVEMRXBUF_H
@@ -1269,3 +1269,178 @@ try {
     printf("Error: %s\n",e.what());
 }
 }
+
+/** @brief Set or show software rate limit of event codes
+ *
+ * Limits how often callbacks and I/O Intr scans are run for an event code
+ * mapped into the FIFO.  Timestamps, TS buffers and other internal actions
+ * still see every occurrence.
+ *
+ @code
+   > mrmEvrEventPolicy("EVR1", 0) # Print current policies and counts
+   > mrmEvrEventPolicy("EVR1", 42, 10) # Run for every 10th occurrence of 42
+   > mrmEvrEventPolicy("EVR1", 42, 0, 5.0) # Run at most 5 times per second
+   > mrmEvrEventPolicy("EVR1", 42, 0, 0, 1) # Run once more for occurrences while busy
+ @endcode
+ *
+ @param id EVR identifier
+ @param evt Event code.  <=0 to print
+ @param every Run for every Nth occurrence.  0 or 1 for all
+ @param maxRate Maximum rate (Hz).  0 for no limit
+ @param coalesce If non-zero, scan once more after completion for occurrences while busy
+ */
+void
+mrmEvrEventPolicy(const char* id, int evt, int every, double maxRate, int coalesce)
+{
+try {
+    mrf::Object *obj=mrf::Object::getObject(id);
+    if(!obj)
+        throw std::runtime_error("Object not found");
+    EVRMRM *card=dynamic_cast<EVRMRM*>(obj);
+    if(!card)
+        throw std::runtime_error("Not a MRM EVR");
+
+    if(evt>0) {
+        if(every<0)
+            throw std::runtime_error("every must be >=0");
+        card->eventPolicySet(evt, every, maxRate, coalesce);
+        return;
+    }
+
+    epicsUInt32 overrate[256], decimated[256];
+    card->FIFOOverRateCodes(overrate, 256u);
+    card->FIFODecimatedCodes(decimated, 256u);
+
+    printf("Code  Every   MaxRate  Coalesce   OverRate  Decimated\n");
+    for(epicsUInt32 code=1; code<=255; code++) {
+        epicsUInt32 E;
+        double R;
+        bool C;
+        card->eventPolicy(code, &E, &R, &C);
+        if(E<=1u && R==0.0 && !C && !overrate[code] && !decimated[code])
+            continue;
+        printf("%4u  %5u  %8.2f  %8s %10u %10u\n", code, E, R, C ? "Yes" : "No",
+               overrate[code], decimated[code]);
+    }
+
+} catch(std::exception& e) {
+    printf("Error: %s\n",e.what());
+}
+}
+
+/**
+ * Poll the event FIFO from a dedicated thread instead of waiting for interrupts.
+ * Removes interrupt delivery and thread wakeups from event latency,
+ * at the cost of one CPU.  Must be called before iocInit.
+ @code
+   > mrmEvrBusyPoll("EVR1", 3, 90, -1) # Pin to CPU 3 at SCHED_FIFO 90, never sleep
+   > mrmEvrBusyPoll("EVR1", -1, 0, 0.01) # Sleep after 10ms without events
+ @endcode
+ *
+ @param id EVR identifier
+ @param cpu CPU to pin the polling thread to.  -1 for none
+ @param priority SCHED_FIFO priority 1-99.  0 for the default EPICS priority
+ @param spin Seconds to keep polling after the last event before sleeping.  <0 to never sleep
+ */
+void
+mrmEvrBusyPoll(const char* id, int cpu, int priority, double spin)
+{
+try {
+    mrf::Object *obj=mrf::Object::getObject(id);
+    if(!obj)
+        throw std::runtime_error("Object not found");
+    EVRMRM *card=dynamic_cast<EVRMRM*>(obj);
+    if(!card)
+        throw std::runtime_error("Not a MRM EVR");
+
+    card->busyPollSetup(cpu, priority, spin);
+
+} catch(std::exception& e) {
+    printf("Error: %s\n",e.what());
+}
+}
+
+// upper bound of log2 latency bucket, with units
+static
+void printLatBucket(unsigned bucket)
+{
+    double ns = double(epicsUInt64(2u)<<bucket);
+    if(bucket>=EVRMRM::LatNBuckets-1u)
+        printf(" %9s", "longer");
+    else if(ns<1e3)
+        printf(" %6.0f ns", ns);
+    else if(ns<1e6)
+        printf(" %6.1f us", ns*1e-3);
+    else
+        printf(" %6.1f ms", ns*1e-6);
+}
+
+// bucket containing fraction of the total count
+static
+unsigned latQuantile(const epicsUInt32 *hist, epicsUInt64 total, double frac)
+{
+    epicsUInt64 sum = 0u;
+    for(unsigned i=0; i<EVRMRM::LatNBuckets; i++) {
+        sum += hist[i];
+        if(sum>=frac*total)
+            return i;
+    }
+    return EVRMRM::LatNBuckets-1u;
+}
+
+/** @brief Print event latency histogram summary
+ *
+ * Requires latency instrumentation to be enabled (Latency Enable property).
+ * Latencies are upper bounds of log2 bins.
+ *
+ @param id EVR identifier
+ @param evt Event code.  <=0 for all codes which have been measured.
+ */
+void
+mrmEvrLatencyReport(const char* id, int evt)
+{
+try {
+    mrf::Object *obj=mrf::Object::getObject(id);
+    if(!obj)
+        throw std::runtime_error("Object not found");
+    EVRMRM *card=dynamic_cast<EVRMRM*>(obj);
+    if(!card)
+        throw std::runtime_error("Not a MRM EVR");
+    if(evt>255)
+        throw std::runtime_error("Event code out of range");
+
+    static const char* const stages[EVRMRM::LatNStages] = {"IRQ", "Dispatch", "Callback", "Total"};
+
+    if(!card->latencyEnabled())
+        printf("Latency instrumentation not enabled\n");
+
+    printf("Code  Stage         Count       p50       p99       max\n");
+    for(int code = evt>0 ? evt : 1; code <= (evt>0 ? evt : 255); code++) {
+        for(unsigned stage=0; stage<EVRMRM::LatNStages; stage++) {
+            epicsUInt32 hist[EVRMRM::LatNBuckets];
+            card->latencyHist(code, EVRMRM::latStage_t(stage), hist);
+
+            epicsUInt64 total = 0u;
+            unsigned max = 0u;
+            for(unsigned i=0; i<EVRMRM::LatNBuckets; i++) {
+                total += hist[i];
+                if(hist[i])
+                    max = i;
+            }
+            if(!total && evt<=0)
+                continue;
+
+            printf("%4d  %-8s %10llu", code, stages[stage], (unsigned long long)total);
+            if(total) {
+                printLatBucket(latQuantile(hist, total, 0.5));
+                printLatBucket(latQuantile(hist, total, 0.99));
+                printLatBucket(max);
+            }
+            printf("\n");
+        }
+    }
+
+} catch(std::exception& e) {
+    printf("Error: %s\n",e.what());
+}
+}
@@ -4,34 +4,88 @@
 * in file LICENSE that is included with this distribution.
 \*************************************************************************/
 
+#include <cmath>
+
 #include "drvem.h"
 #include "drvemTSBuffer.h"
 #include "devObj.h"
 
+#define TSBufMaxDepth 1024u
+
 EVRMRMTSBuffer::EVRMRMTSBuffer(const std::string &n, EVRMRM *evr)
     :base_t(n)
     ,evr(evr)
     ,dropped(0u)
+    ,overrun(0u)
     ,timeEvt(0u)
     ,flushEvt(0u)
+    ,statsEna(false)
+    ,histLow(0.0)
+    ,histBin(1000.0)
     ,active(0u)
+    ,bufSize(0u)
+    ,readSel(0u)
 {
     scanIoInit(&scan);
+    // not yet known to the FIFO dispatch thread, so no locking needed
+    depthSet(2u);
 }
 
 EVRMRMTSBuffer::~EVRMRMTSBuffer()
 {
+    for(size_t i=0; i<ebufs.size(); i++)
+        delete ebufs[i];
+}
 
+// caller must hold dispatchLock
+void EVRMRMTSBuffer::depthSet(epicsUInt32 v)
+{
+    if(v==ebufs.size())
+        return;
+    if(v<2u || v>TSBufMaxDepth)
+        throw std::invalid_argument(SB()<<"TS buffer depth must be in range [2, "<<TSBufMaxDepth<<"]");
+
+    std::vector<ebuf_t*> next(v, (ebuf_t*)0);
+    try {
+        for(size_t i=ebufs.empty() ? 0u : 1u; i<next.size(); i++) {
+            next[i] = new ebuf_t;
+            next[i]->buf.resize(bufSize);
+        }
+    } catch(...) {
+        for(size_t i=0; i<next.size(); i++)
+            delete next[i];
+        throw;
+    }
+
+    if(ebufs.empty()) {
+        next[0]->seq = 1u;
+    } else {
+        // keep the interval being filled, discard completed intervals
+        next[0] = ebufs[active];
+        ebufs[active] = 0;
+        for(size_t i=0; i<ebufs.size(); i++)
+            delete ebufs[i];
+    }
+
+    ebufs.swap(next);
+    active = 0u;
+    cursors.clear();
+}
+
+epicsUInt32 EVRMRMTSBuffer::flushSeq() const
+{
+    return ebufs[active]->seq-1u;
 }
 
+// buffers are filled by the FIFO dispatch thread, which holds dispatchLock
 void EVRMRMTSBuffer::lock() const
 {
-    evr->lock();
+    evr->dispatchLock.lock();
 }
 
 void EVRMRMTSBuffer::unlock() const
 {
-    evr->unlock();
+    evr->dispatchLock.unlock();
 }
 
 void EVRMRMTSBuffer::flushTimeSet(epicsUInt16 v)
@@ -42,12 +96,12 @@ void EVRMRMTSBuffer::flushTimeSet(epicsUInt16 v)
         throw std::invalid_argument("Can't capture with flush code or >255");
 
     if(timeEvt) {
-        evr->events[timeEvt].tbufs.erase(this);
+        evr->events[timeEvt].tbufs.remove(this);
         evr->interestedInEvent(timeEvt, false);
     }
     if(v) {
         evr->interestedInEvent(v, true);
-        evr->events[v].tbufs.insert(this);
+        evr->events[v].tbufs.push_back(this);
     }
     timeEvt = v;
 }
@@ -60,24 +114,25 @@ void EVRMRMTSBuffer::flushEventSet(epicsUInt16 v)
         throw std::invalid_argument("Can't flush with capture code or >255");
 
     if(flushEvt) {
-        evr->events[flushEvt].tbufs.erase(this);
+        evr->events[flushEvt].tbufs.remove(this);
         evr->interestedInEvent(flushEvt, false);
     }
     if(v) {
         evr->interestedInEvent(v, true);
-        evr->events[v].tbufs.insert(this);
+        evr->events[v].tbufs.push_back(this);
     }
     flushEvt = v;
 }
 
-// caller must hold evrLock
+// caller must hold dispatchLock
 void EVRMRMTSBuffer::flushNow()
 {
-    if(epicsTimeGetCurrent(&ebufs[active].flushtime)) {
-        ebufs[active].flushtime.secPastEpoch = 0u;
-        ebufs[active].flushtime.nsec = 0u;
-        ebufs[active].ok = false;
-        ebufs[active].drop = false;
+    ebuf_t& cur = *ebufs[active];
+    if(epicsTimeGetCurrent(&cur.flushtime)) {
+        cur.flushtime.secPastEpoch = 0u;
+        cur.flushtime.nsec = 0u;
+        cur.ok = false;
+        cur.drop = false;
     }
 
     doFlush();
@@ -85,22 +140,172 @@ void EVRMRMTSBuffer::flushNow()
 
 void EVRMRMTSBuffer::doFlush()
 {
-    bool prevok = ebufs[active].ok;
-    epicsTimeStamp prevflushtime = ebufs[active].flushtime;
+    ebuf_t& prev = *ebufs[active];
+
+    active = (active+1u)%ebufs.size();
+    ebuf_t& next = *ebufs[active];
+
+    // oldest completed interval is lost
+    if(next.seq && !next.read)
+        overrun++;
+
+    // forget records which have not read it, or any later interval.
+    // They resume with the latest.
+    if(next.seq) {
+        for(cursors_t::iterator it(cursors.begin()), end(cursors.end()); it!=end;) {
+            cursors_t::iterator cur(it++);
+            if(epicsInt32(cur->second-next.seq)<0)
+                cursors.erase(cur);
+        }
+    }
 
-    active ^= 1u;
+    next.seq = prev.seq+1u;
+    if(!next.seq)
+        next.seq = 1u; // 0 is never a valid interval
 
-    ebufs[active].pos = 0u;
+    next.pos = 0u;
     // a valid buffer requires timestamp validity at start and end flush
-    ebufs[active].ok = evr->TimeStampValid();
-    ebufs[active].drop = false;
+    next.ok = evr->TimeStampValid();
+    next.drop = false;
+    next.read = false;
 
-    ebufs[active].prevok = prevok;
-    ebufs[active].prevflushtime = prevflushtime;
+    next.prevok = prev.ok;
+    next.prevflushtime = prev.flushtime;
+
+    prev.stats.finish((epicsInt64(prev.flushtime.secPastEpoch) + POSIX_TIME_AT_EPICS_EPOCH)*1000000000
+                      + prev.flushtime.nsec);
+    next.stats.reset(statsEna, histLow, histBin);
 
     scanIoRequest(scan);
 }
 
+void EVRMRMTSBuffer::stats_t::reset(bool ena, double low, double bin)
+{
+    enabled = ena;
+    count = 0u;
+    first = prev = 0;
+    histLow = low;
+    histBin = bin;
+    ivalMin = ivalMax = ivalMean = ivalM2 = 0.0;
+    offMin = offMax = offMean = offM2 = 0.0;
+    for(size_t i=0; i<HistBins; i++)
+        hist[i] = 0u;
+}
+
+// called from FIFO dispatch thread for each capture
+void EVRMRMTSBuffer::stats_t::add(epicsInt64 t)
+{
+    if(!enabled)
+        return;
+
+    if(count==0u) {
+        first = t;
+
+    } else {
+        double ival = double(t-prev);
+
+        if(count==1u) {
+            ivalMin = ivalMax = ival;
+        } else {
+            ivalMin = std::min(ivalMin, ival);
+            ivalMax = std::max(ivalMax, ival);
+        }
+
+        // Welford's method.  count-1 intervals so far.
+        double delta = ival-ivalMean;
+        ivalMean += delta/count;
+        ivalM2 += delta*(ival-ivalMean);
+
+        double bin = (ival-histLow)/histBin;
+        if(!(bin>0.0))
+            bin = 0.0; // also NaN
+        else if(bin>=HistBins-1)
+            bin = HistBins-1;
+        hist[size_t(bin)]++;
+    }
+
+    prev = t;
+    count++;
+
+    double off = double(t-first);
+    if(count==1u) {
+        offMin = offMax = off;
+    } else {
+        offMin = std::min(offMin, off);
+        offMax = std::max(offMax, off);
+    }
+    double delta = off-offMean;
+    offMean += delta/count;
+    offM2 += delta*(off-offMean);
+}
+
+void EVRMRMTSBuffer::stats_t::finish(epicsInt64 flush)
+{
+    if(!count)
+        return;
+    // spread is unchanged by shifting the origin
+    double shift = double(flush-first);
+    offMin -= shift;
+    offMax -= shift;
+    offMean -= shift;
+}
+
+EVRMRMTSBuffer::ebuf_t* EVRMRMTSBuffer::findSeq(epicsUInt32 seq)
+{
+    if(!seq)
+        return 0;
+    for(size_t i=0; i<ebufs.size(); i++) {
+        if(i!=active && ebufs[i]->seq==seq)
+            return ebufs[i];
+    }
+    return 0;
+}
+
+// Pick the interval to read out.  Each record steps through intervals in order
+// (catching up after falling behind) so that no interval is missed
+// while it remains in the ring.
+EVRMRMTSBuffer::ebuf_t* EVRMRMTSBuffer::nextReadout(const dbCommon *prec, epicsUInt32 count)
+{
+    if(bufSize < count) {
+        bufSize = count;
+        for(size_t i=0; i<ebufs.size(); i++)
+            ebufs[i]->buf.resize(bufSize);
+    }
+
+    const epicsUInt32 latest = flushSeq();
+    epicsUInt32 want = latest;
+
+    if(readSel) {
+        want = readSel;
+
+    } else if(prec) {
+        cursors_t::const_iterator it(cursors.find(prec));
+        if(it!=cursors.end() && epicsInt32(it->second+1u-latest)<=0) {
+            want = it->second+1u;
+
+            // find oldest completed interval
+            epicsUInt32 oldest = latest;
+            for(size_t i=1u; i<ebufs.size(); i++) {
+                const ebuf_t *buf = ebufs[(active+i)%ebufs.size()];
+                if(buf->seq) {
+                    oldest = buf->seq;
+                    break;
+                }
+            }
+            if(epicsInt32(want-oldest)<0)
+                want = oldest;
+        }
+    }
+
+    ebuf_t *ret = findSeq(want);
+    if(ret) {
+        ret->read = true;
+        if(prec && !readSel)
+            cursors[prec] = want;
+    }
+    return ret;
+}
+
 enum TimesRef {
     TimesRefEvt0,
     TimesRefFlush,
@@ -108,10 +313,18 @@ enum TimesRef {
 };
 
 static
-epicsUInt32 getTimes(const EVRMRMTSBuffer* self, epicsInt32 *arr, epicsUInt32 count, TimesRef ref)
+epicsUInt32 getTimes(EVRMRMTSBuffer* self, epicsInt32 *arr, epicsUInt32 count, TimesRef ref)
 {
-    const EVRMRMTSBuffer::ebuf_t& readout = self->ebufs[self->active^1u];
     dbCommon* prec = CurrentRecord::get();
+    const EVRMRMTSBuffer::ebuf_t* slot = self->nextReadout(prec, count);
+
+    if(!slot) {
+        // requested interval not (yet or any longer) buffered
+        if(prec)
+            recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
+        return 0u;
+    }
+    const EVRMRMTSBuffer::ebuf_t& readout = *slot;
 
     if(prec && !readout.ok) {
         recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
@@ -121,45 +334,38 @@ epicsUInt32 getTimes(const EVRMRMTSBuffer* self, epicsInt32 *arr, epicsUInt32 co
         recGblSetSevr(prec, READ_ALARM, MAJOR_ALARM);
     }
 
-    double period=1e9/self->evr->clockTS(); // in nanoseconds
+    const TickScale scale(self->evr->tickScale());
 
     size_t len = std::min(readout.pos, size_t(count));
 
-    if(readout.buf.size() < count) {
-        const_cast<EVRMRMTSBuffer::ebuf_t&>(readout).buf.resize(count);
-    }
-
-    if(period<=0 || !isfinite(period)) {
+    if(!scale.valid()) {
         if(count>0u) {
             arr[0] = 0;
             count = 1u;
         }
-        recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
+        if(prec)
+            recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
         return count;
     }
 
+    // readout.ok captures validity of timestamp at start and end of interval.
+    // skip validation of timestamps in between.
     epicsTimeStamp tref;
     if(ref==TimesRefFlush) {
         tref = readout.flushtime;
     } else if(ref==TimesRefPrevFlush) {
         tref = readout.prevflushtime;
+    } else if(len>0u) {
+        tref.secPastEpoch = readout.buf[0].secPastEpoch - POSIX_TIME_AT_EPICS_EPOCH;
+        tref.nsec = epicsUInt32(scale.toNS(readout.buf[0].nsec));
+    } else {
+        tref = readout.flushtime;
     }
 
-    for(size_t i=0; i<len; i++) {
-        epicsTimeStamp ts = readout.buf[i];
-
-        // readout.ok captures validity of timestamp at start and end of interval.
-        // skip validation of timestamps in between.
-        ts.secPastEpoch -= POSIX_TIME_AT_EPICS_EPOCH;
-        ts.nsec = epicsUInt32(ts.nsec*period);
-
-        if(i==0 && ref==TimesRefEvt0) {
-            tref = ts;
-        }
-
-        double diff = epicsTimeDiffInSeconds(&ts, &tref);
-        arr[i] = epicsInt32(diff*1e9); // ns
-    }
+    // raw times are POSIX seconds and ticks.  Convert all in one pass.
+    if(len>0u)
+        scale.relativeNS(arr, &readout.buf[0], len,
+                         tref.secPastEpoch + POSIX_TIME_AT_EPICS_EPOCH, tref.nsec);
 
     if(prec) {
         prec->time = tref;
@@ -170,17 +376,107 @@ epicsUInt32 getTimes(const EVRMRMTSBuffer* self, epicsInt32 *arr, epicsUInt32 co
 
 epicsUInt32 EVRMRMTSBuffer::getTimesRelFirst(epicsInt32 *arr, epicsUInt32 count) const
 {
-    return getTimes(this, arr, count, TimesRefEvt0);
+    return getTimes(reader(), arr, count, TimesRefEvt0);
 }
 
 epicsUInt32 EVRMRMTSBuffer::getTimesRelFlush(epicsInt32 *arr, epicsUInt32 count) const
 {
-    return getTimes(this, arr, count, TimesRefFlush);
+    return getTimes(reader(), arr, count, TimesRefFlush);
 }
 
 epicsUInt32 EVRMRMTSBuffer::getTimesRelPrevFlush(epicsInt32 *arr, epicsUInt32 count) const
 {
-    return getTimes(this, arr, count, TimesRefPrevFlush);
+    return getTimes(reader(), arr, count, TimesRefPrevFlush);
+}
+
+void EVRMRMTSBuffer::histWidthSet(double v)
+{
+    if(!(v>0.0))
+        throw std::invalid_argument("Histogram bin width must be positive");
+    histBin = v;
+}
+
+const EVRMRMTSBuffer::stats_t* EVRMRMTSBuffer::readStats()
+{
+    dbCommon* prec = CurrentRecord::get();
+    const ebuf_t* slot = nextReadout(prec, 0u);
+
+    if(!slot || !slot->stats.enabled) {
+        if(prec)
+            recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
+        return 0;
+    }
+    if(prec) {
+        if(!slot->ok)
+            recGblSetSevr(prec, READ_ALARM, INVALID_ALARM);
+        prec->time = slot->flushtime;
+    }
+    return &slot->stats;
+}
+
+epicsUInt32 EVRMRMTSBuffer::statCount() const
+{
+    const stats_t *S = reader()->readStats();
+    return S ? S->count : 0u;
+}
+
+double EVRMRMTSBuffer::intervalMin() const
+{
+    const stats_t *S = reader()->readStats();
+    return S ? S->ivalMin : 0.0;
+}
+
+double EVRMRMTSBuffer::intervalMax() const
+{
+    const stats_t *S = reader()->readStats();
+    return S ? S->ivalMax : 0.0;
+}
+
+double EVRMRMTSBuffer::intervalMean() const
+{
+    const stats_t *S = reader()->readStats();
+    return S ? S->ivalMean : 0.0;
+}
+
+double EVRMRMTSBuffer::intervalStd() const
+{
+    const stats_t *S = reader()->readStats();
+    return S && S->count>1u ? sqrt(S->ivalM2/(S->count-1u)) : 0.0;
+}
+
+double EVRMRMTSBuffer::offsetMin() const
+{
+    const stats_t *S = reader()->readStats();
+    return S ? S->offMin : 0.0;
+}
+
+double EVRMRMTSBuffer::offsetMax() const
+{
+    const stats_t *S = reader()->readStats();
+    return S ? S->offMax : 0.0;
+}
+
+double EVRMRMTSBuffer::offsetMean() const
+{
+    const stats_t *S = reader()->readStats();
+    return S ? S->offMean : 0.0;
+}
+
+double EVRMRMTSBuffer::offsetStd() const
+{
+    const stats_t *S = reader()->readStats();
+    return S && S->count>0u ? sqrt(S->offM2/S->count) : 0.0;
+}
+
+epicsUInt32 EVRMRMTSBuffer::intervalHist(epicsUInt32 *arr, epicsUInt32 count) const
+{
+    const stats_t *S = reader()->readStats();
+    if(!S)
+        return 0u;
+    count = std::min(count, epicsUInt32(stats_t::HistBins));
+    for(epicsUInt32 i=0; i<count; i++)
+        arr[i] = S->hist[i];
+    return count;
 }
 
 static
@@ -209,6 +505,11 @@ buildInstance(const std::string& name, const std::string& klass, const mrf::Obje
 OBJECT_BEGIN(EVRMRMTSBuffer)
     OBJECT_FACTORY(&buildInstance);
     OBJECT_PROP1("DropCnt", &EVRMRMTSBuffer::dropCount);
+    OBJECT_PROP1("OverrunCnt", &EVRMRMTSBuffer::overrunCount);
+    OBJECT_PROP2("Depth", &EVRMRMTSBuffer::depth, &EVRMRMTSBuffer::depthSet);
+    OBJECT_PROP1("FlushSeq", &EVRMRMTSBuffer::flushSeq);
+    OBJECT_PROP1("FlushSeq", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP2("ReadSeq", &EVRMRMTSBuffer::readSeq, &EVRMRMTSBuffer::readSeqSet);
     OBJECT_PROP2("TimeEvent", &EVRMRMTSBuffer::timeEvent, &EVRMRMTSBuffer::flushTimeSet);
     OBJECT_PROP2("FlushEvent", &EVRMRMTSBuffer::flushEvent, &EVRMRMTSBuffer::flushEventSet);
     OBJECT_PROP1("FlushManual", &EVRMRMTSBuffer::flushNow);
@@ -218,4 +519,27 @@ OBJECT_BEGIN(EVRMRMTSBuffer)
     OBJECT_PROP1("TimesRelFlush", &EVRMRMTSBuffer::flushed);
     OBJECT_PROP1("TimesRelPrevFlush", &EVRMRMTSBuffer::getTimesRelPrevFlush);
     OBJECT_PROP1("TimesRelPrevFlush", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP2("StatsEnable", &EVRMRMTSBuffer::statsEnabled, &EVRMRMTSBuffer::statsEnable);
+    OBJECT_PROP2("HistStart", &EVRMRMTSBuffer::histStart, &EVRMRMTSBuffer::histStartSet);
+    OBJECT_PROP2("HistWidth", &EVRMRMTSBuffer::histWidth, &EVRMRMTSBuffer::histWidthSet);
+    OBJECT_PROP1("StatCount", &EVRMRMTSBuffer::statCount);
+    OBJECT_PROP1("StatCount", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP1("IntervalMin", &EVRMRMTSBuffer::intervalMin);
+    OBJECT_PROP1("IntervalMin", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP1("IntervalMax", &EVRMRMTSBuffer::intervalMax);
+    OBJECT_PROP1("IntervalMax", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP1("IntervalMean", &EVRMRMTSBuffer::intervalMean);
+    OBJECT_PROP1("IntervalMean", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP1("IntervalStd", &EVRMRMTSBuffer::intervalStd);
+    OBJECT_PROP1("IntervalStd", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP1("OffsetMin", &EVRMRMTSBuffer::offsetMin);
+    OBJECT_PROP1("OffsetMin", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP1("OffsetMax", &EVRMRMTSBuffer::offsetMax);
+    OBJECT_PROP1("OffsetMax", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP1("OffsetMean", &EVRMRMTSBuffer::offsetMean);
+    OBJECT_PROP1("OffsetMean", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP1("OffsetStd", &EVRMRMTSBuffer::offsetStd);
+    OBJECT_PROP1("OffsetStd", &EVRMRMTSBuffer::flushed);
+    OBJECT_PROP1("IntervalHist", &EVRMRMTSBuffer::intervalHist);
+    OBJECT_PROP1("IntervalHist", &EVRMRMTSBuffer::flushed);
 OBJECT_END(EVRMRMTSBuffer)
@@ -7,6 +7,7 @@
 #define DRVEMTSBUFFER_H
 
 #include <vector>
+#include <map>
 #include <utility> // std::pair
 
 #include <dbScan.h>
@@ -14,6 +15,7 @@
 #include "mrf/object.h"
 
 class EVRMRM;
+struct dbCommon;
 
 struct EVRMRMTSBuffer : public mrf::ObjectInst<EVRMRMTSBuffer>
 {
@@ -26,6 +28,22 @@ struct EVRMRMTSBuffer : public mrf::ObjectInst<EVRMRMTSBuffer>
     virtual void unlock() const OVERRIDE FINAL;
 
     epicsUInt32 dropCount() const { return dropped; }
+    epicsUInt32 overrunCount() const { return overrun; }
+
+    //! Number of flush intervals kept.  One is being filled, the rest may be read out.
+    epicsUInt32 depth() const { return epicsUInt32(ebufs.size()); }
+    //! Discards all buffered intervals
+    void depthSet(epicsUInt32 v);
+
+    //! Sequence number of the most recently completed interval
+    epicsUInt32 flushSeq() const;
+
+    /** Select a specific interval to read out.
+     *  0 (default) reads each interval in order for each record,
+     *  or the latest when not called from a record.
+     */
+    epicsUInt32 readSeq() const { return readSel; }
+    void readSeqSet(epicsUInt32 v) { readSel = v; }
 
     epicsUInt16 timeEvent() const { return timeEvt; }
     void flushTimeSet(epicsUInt16 v);
@@ -40,34 +58,103 @@ struct EVRMRMTSBuffer : public mrf::ObjectInst<EVRMRMTSBuffer>
     epicsUInt32 getTimesRelFlush(epicsInt32 *arr, epicsUInt32 count) const;
     epicsUInt32 getTimesRelPrevFlush(epicsInt32 *arr, epicsUInt32 count) const;
 
+    //! Compute statistics of each interval as events are captured
+    bool statsEnabled() const { return statsEna; }
+    void statsEnable(bool v) { statsEna = v; }
+
+    //! Lower edge of first histogram bin in ns
+    double histStart() const { return histLow; }
+    void histStartSet(double v) { histLow = v; }
+    //! Histogram bin width in ns
+    double histWidth() const { return histBin; }
+    void histWidthSet(double v);
+
+    // Statistics of interval read out.  Times in ns.
+    epicsUInt32 statCount() const;
+    double intervalMin() const;
+    double intervalMax() const;
+    double intervalMean() const;
+    double intervalStd() const;
+    double offsetMin() const;
+    double offsetMax() const;
+    double offsetMean() const;
+    double offsetStd() const;
+    //! Histogram of time between captures
+    epicsUInt32 intervalHist(epicsUInt32 *arr, epicsUInt32 count) const;
+
     IOSCANPVT flushed() const { return scan; }
 
     EVRMRM* const evr;
 
     epicsUInt32 dropped;
+    epicsUInt32 overrun; // completed intervals overwritten before being read
 
     IOSCANPVT scan;
 
     epicsUInt8 timeEvt;
     epicsUInt8 flushEvt;
 
+    bool statsEna;
+    double histLow, histBin;
+
+    // Running statistics of one interval
+    struct stats_t {
+        enum {HistBins=64};
+        bool enabled;
+        epicsUInt32 count;
+        epicsInt64 first, prev; // ns
+        double histLow, histBin;
+        // time between captures.  Running mean, and sum of squared differences from mean.
+        double ivalMin, ivalMax, ivalMean, ivalM2;
+        // offset relative to first capture until finish(), then relative to flush
+        double offMin, offMax, offMean, offM2;
+        // under/over flows in first/last bin
+        epicsUInt32 hist[HistBins];
+
+        stats_t() { reset(false, 0.0, 1.0); }
+        void reset(bool ena, double low, double bin);
+        //! Add capture at ns
+        void add(epicsInt64 t);
+        //! Interval flushed at ns
+        void finish(epicsInt64 flush);
+    };
+
     struct ebuf_t {
+        epicsUInt32 seq; // interval sequence number.  0 if never filled
         size_t pos;
         std::vector<epicsTimeStamp> buf;
         epicsTimeStamp flushtime, prevflushtime;
         bool ok, prevok;
         bool drop;
-        ebuf_t() :pos(0u), ok(false), prevok(false), drop(false) {
+        bool read;
+        stats_t stats;
+        ebuf_t() :seq(0u), pos(0u), ok(false), prevok(false), drop(false), read(false) {
             flushtime.secPastEpoch = 0u;
             flushtime.nsec = 0u;
             prevflushtime = flushtime;
         }
     private:
         ebuf_t(const ebuf_t&);
-    } ebufs[2];
-    // active buffer being filled.  Other is for readout.
-    // must lock both evr and this mutex to change.
-    unsigned char active; // either 0 or 1
+    };
+    // Ring of flush intervals.  ebufs[active] is being filled.
+    // Others are completed, oldest at active+1.
+    // guarded by EVRMRM::dispatchLock
+    std::vector<ebuf_t*> ebufs;
+    size_t active;
+    // Capacity of each slot.  Grows to largest reader.
+    size_t bufSize;
+
+    epicsUInt32 readSel;
+    // Last interval read by each record, also guarded by EVRMRM::dispatchLock.
+    // Entries for intervals no longer buffered are pruned by doFlush().
+    typedef std::map<const dbCommon*, epicsUInt32> cursors_t;
+    cursors_t cursors;
+
+    ebuf_t* findSeq(epicsUInt32 seq);
+    ebuf_t* nextReadout(const dbCommon *prec, epicsUInt32 count);
+    const stats_t* readStats();
+    // Readout moves the cursor of the calling record, while property getters are const
+    EVRMRMTSBuffer* reader() const { return const_cast<EVRMRMTSBuffer*>(this); }
 };
 
 #endif // DRVEMTSBUFFER_H
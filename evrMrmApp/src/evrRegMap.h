@@ -90,6 +90,8 @@
 #  define Control_fiforst 0x00000008
 
 #define U32_IRQFlag     0x008
+/* Segmented data buffer, 300 series */
+#  define IRQ_SegDBuf   0x2000
 #  define IRQ_EoS       0x1000
 #  define IRQ_SoS       0x0100
 #  define IRQ_LinkChg   0x40
@@ -353,6 +355,19 @@
 #define U32_OutputCMLCount(N) (U32_OutputCMLNCount +(0x20*(N)))
 #define U32_OutputCMLPatLength(N) (U32_OutputCMLNPatLength +(0x20*(N)))
 
+/* Segmented data buffer (300 series).
+ * 128 bits for each of the 16 byte segments of DataRx.
+ * Segment 0 is the MSB of the first word.  Write 1 to clear.
+ */
+#define U32_SegRxFlag_base   0x0780
+#define U32_SegRxChkErr_base 0x07a0
+#define U32_SegRxOvfl_base   0x07c0
+
+/* 0 <= N <= 3 */
+#define U32_SegRxFlag(N)   (U32_SegRxFlag_base + 4*(N))
+#define U32_SegRxChkErr(N) (U32_SegRxChkErr_base + 4*(N))
+#define U32_SegRxOvfl(N)   (U32_SegRxOvfl_base + 4*(N))
+
 #define U32_DataRx_base     0x0800
 #define U32_DataTx_base     0x1800
 #define U32_EventLog_base   0x2000
@@ -0,0 +1,84 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#if defined(__SSSE3__)
+#  include <tmmintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+#include <epicsEndian.h>
+#include <epicsMMIO.h>
+
+#include "mmiocopy.h"
+
+void mmioCopyBE32Word(epicsUInt32 *dst, volatile void *src, size_t count)
+{
+    volatile epicsUInt8 *reg = (volatile epicsUInt8 *)src;
+    for(size_t i=0; i<count; i++)
+        dst[i] = be_ioread32(reg + 4u*i);
+}
+
+void mmioCopyBE32(epicsUInt32 *dst, volatile void *src, size_t count, bool wide)
+{
+#if defined(MMIO_HAVE_WIDE)
+    if(wide) {
+        volatile epicsUInt8 *reg = (volatile epicsUInt8 *)src;
+        size_t i=0;
+        /* Bus reads in ascending address order, 4 words each.
+         * The load is not volatile, but each result is stored,
+         * so none can be elided.
+         */
+        for(; i+4u<=count; i+=4u) {
+            __m128i W = _mm_load_si128((const __m128i*)(reg + 4u*i));
+            _mm_storeu_si128((__m128i*)&dst[i], W);
+        }
+        for(; i<count; i++)
+            dst[i] = nat_ioread32(reg + 4u*i);
+        // registers now in dst with bus byte order
+        mmioSwapBE32(dst, count);
+        return;
+    }
+#else
+    (void)wide;
+#endif
+    mmioCopyBE32Word(dst, src, count);
+}
+
+void mmioSwapBE32Scalar(epicsUInt32 *buf, size_t count)
+{
+#if EPICS_BYTE_ORDER == EPICS_ENDIAN_LITTLE
+    for(size_t i=0; i<count; i++) {
+        epicsUInt32 v = buf[i];
+        buf[i] = (v<<24) | ((v&0xff00u)<<8) | ((v>>8)&0xff00u) | (v>>24);
+    }
+#else
+    (void)buf;
+    (void)count;
+#endif
+}
+
+void mmioSwapBE32(epicsUInt32 *buf, size_t count)
+{
+    size_t i=0;
+#if EPICS_BYTE_ORDER == EPICS_ENDIAN_LITTLE
+#  if defined(__SSSE3__)
+    const __m128i rev = _mm_set_epi8(12,13,14,15, 8,9,10,11, 4,5,6,7, 0,1,2,3);
+    for(; i+4u<=count; i+=4u) {
+        __m128i W = _mm_loadu_si128((const __m128i*)&buf[i]);
+        _mm_storeu_si128((__m128i*)&buf[i], _mm_shuffle_epi8(W, rev));
+    }
+#  elif defined(__SSE2__)
+    // no byte shuffle in SSE2.  Swap bytes within 16-bit halves, then swap halves.
+    for(; i+4u<=count; i+=4u) {
+        __m128i W = _mm_loadu_si128((const __m128i*)&buf[i]);
+        W = _mm_or_si128(_mm_slli_epi16(W, 8), _mm_srli_epi16(W, 8));
+        W = _mm_shufflehi_epi16(_mm_shufflelo_epi16(W, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+        _mm_storeu_si128((__m128i*)&buf[i], W);
+    }
+#  endif
+#endif
+    mmioSwapBE32Scalar(buf+i, count-i);
+}
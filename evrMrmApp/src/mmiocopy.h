@@ -0,0 +1,45 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+#ifndef MMIOCOPY_H
+#define MMIOCOPY_H
+
+#include <stddef.h>
+
+#include <epicsTypes.h>
+
+/* Wide MMIO reads are only attempted on x86 with SSE2, where a PCI(e) bridge
+ * completes 16 byte reads from a memory BAR.  Elsewhere (VME, PPC, ARM, ...)
+ * mmioCopyBE32() is always the per-word loop.
+ * Define MMIO_NO_WIDE to force the per-word loop.
+ */
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__)) && !defined(MMIO_NO_WIDE)
+#  define MMIO_HAVE_WIDE
+#endif
+
+/** @brief Copy a block of big endian 32-bit registers.
+ *
+ * Stores count words to dst, each equal to be_ioread32() of the
+ * corresponding register starting at src.
+ *
+ * When wide is true, and MMIO_HAVE_WIDE is defined, the registers are read with
+ * 16 byte loads into dst, followed by a separate byte order swap pass over dst.
+ * Otherwise one be_ioread32() per word.
+ *
+ * src must be 16 byte aligned.  Caller must know that the bus permits wide reads.
+ */
+void mmioCopyBE32(epicsUInt32 *dst, volatile void *src, size_t count, bool wide);
+
+//! Per-word implementation of mmioCopyBE32()
+void mmioCopyBE32Word(epicsUInt32 *dst, volatile void *src, size_t count);
+
+/** @brief Convert count big endian words in place to host order
+ *
+ * A no-op on big endian hosts.  Uses SIMD instructions where available.
+ */
+void mmioSwapBE32(epicsUInt32 *buf, size_t count);
+//! Portable implementation of mmioSwapBE32()
+void mmioSwapBE32Scalar(epicsUInt32 *buf, size_t count);
+
+#endif // MMIOCOPY_H
@@ -0,0 +1,91 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+/* Micro-benchmark of data buffer copy.
+ *
+ * Compares mmioCopyBE32() with wide reads, against the per-word loop
+ * used previously, and the byte swap pass alone.
+ * The DataRx "registers" here are a cached heap array, so reads are far cheaper
+ * than uncached PCI reads.  The saving from fewer, wider bus reads is not
+ * shown, only the cost of the copy and swap code.
+ */
+
+#include <vector>
+#include <string.h>
+
+#include <epicsTime.h>
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#include "mmiocopy.h"
+
+namespace {
+
+void bench(size_t count)
+{
+    testDiag("With %u words", unsigned(count));
+
+    // 16 byte aligned, like the DataRx registers
+    std::vector<epicsUInt32> store(count+4u);
+    epicsUInt32 *regs = &store[0];
+    while(size_t(regs)&15u)
+        regs++;
+
+    epicsUInt32 x = 12345u;
+    for(size_t i=0; i<count; i++) {
+        x = x*1103515245u + 12345u; // LCG
+        regs[i] = x;
+    }
+
+    std::vector<epicsUInt32> wide(count), word(count), swapped(count);
+
+    // repeat to total about 100M words
+    const size_t reps = 100000000u/count;
+
+    const epicsTime T0(epicsTime::getCurrent());
+    for(size_t r=0; r<reps; r++)
+        mmioCopyBE32(&wide[0], regs, count, true);
+    const epicsTime T1(epicsTime::getCurrent());
+    for(size_t r=0; r<reps; r++)
+        mmioCopyBE32Word(&word[0], regs, count);
+    const epicsTime T2(epicsTime::getCurrent());
+    for(size_t r=0; r<reps; r++)
+        mmioSwapBE32(&swapped[0], count);
+    const epicsTime T3(epicsTime::getCurrent());
+
+    const double N = double(reps*count);
+    testDiag("mmioCopyBE32() wide %.3f ns/word", (T1-T0)*1e9/N);
+    testDiag("per word            %.3f ns/word", (T2-T1)*1e9/N);
+    testDiag("swap pass only      %.3f ns/word", (T3-T2)*1e9/N);
+
+    testOk(memcmp(&wide[0], &word[0], count*4u)==0, "wide matches per word");
+
+    memcpy(&swapped[0], regs, count*4u);
+    mmioSwapBE32(&swapped[0], count);
+    std::vector<epicsUInt32> scalar(regs, regs+count);
+    mmioSwapBE32Scalar(&scalar[0], count);
+    testOk(memcmp(&swapped[0], &scalar[0], count*4u)==0, "swap matches portable");
+}
+
+} // namespace
+
+MAIN(mmiocopyBench)
+{
+    testPlan(8);
+#if defined(MMIO_HAVE_WIDE)
+    testDiag("Using wide reads");
+#else
+    testDiag("Wide reads not available.  Per word only");
+#endif
+#if defined(__SSSE3__)
+    testDiag("Using SSSE3");
+#elif defined(__SSE2__)
+    testDiag("Using SSE2");
+#endif
+    bench(7u); // odd size exercises the tail
+    bench(64u);
+    bench(512u); // full 2KB buffer
+    bench(4096u);
+    return testDone();
+}
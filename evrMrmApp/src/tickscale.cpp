@@ -0,0 +1,59 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+#include "tickscale.h"
+
+void TickScale::relativeNSScalar(epicsInt32 *out, const epicsTimeStamp *in, size_t count,
+                                 epicsUInt32 refSec, epicsUInt32 refNS) const
+{
+    for(size_t i=0; i<count; i++) {
+        epicsInt64 diff = (epicsInt64(in[i].secPastEpoch) - epicsInt64(refSec))*1000000000
+                + epicsInt64(toNS(in[i].nsec)) - epicsInt64(refNS);
+        out[i] = epicsInt32(diff);
+    }
+}
+
+void TickScale::relativeNS(epicsInt32 *out, const epicsTimeStamp *in, size_t count,
+                           epicsUInt32 refSec, epicsUInt32 refNS) const
+{
+    size_t i=0;
+#if defined(__SSE2__)
+    /* Two timestamps per iteration.  Each 64-bit lane holds
+     * one epicsTimeStamp with seconds in the low half, and ticks in the high half.
+     * 64-bit products are made from 32-bit operands with _mm_mul_epu32().
+     */
+    const int H = int(mult>>32u), L = int(mult&0xffffffffu);
+    const __m128i lomask  = _mm_set_epi32(0, -1, 0, -1);
+    const __m128i mhi     = _mm_set_epi32(0, H, 0, H);
+    const __m128i mlo     = _mm_set_epi32(0, L, 0, L);
+    const __m128i billion = _mm_set_epi32(0, 1000000000, 0, 1000000000);
+    const __m128i rsec    = _mm_set_epi32(0, int(refSec), 0, int(refSec));
+    const __m128i rns     = _mm_set_epi32(0, int(refNS), 0, int(refNS));
+
+    for(; i+2u<=count; i+=2u) {
+        __m128i raw   = _mm_loadu_si128((const __m128i*)&in[i]);
+        __m128i ticks = _mm_srli_epi64(raw, 32);
+        __m128i sec   = _mm_and_si128(raw, lomask);
+
+        __m128i ns = _mm_add_epi64(_mm_mul_epu32(ticks, mhi),
+                                   _mm_srli_epi64(_mm_mul_epu32(ticks, mlo), 32));
+
+        // seconds difference times 1e9, modulo 2**64, so negative differences work
+        __m128i dsec = _mm_sub_epi64(sec, rsec);
+        __m128i dns  = _mm_add_epi64(_mm_mul_epu32(dsec, billion),
+                                     _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(dsec, 32), billion), 32));
+
+        __m128i diff = _mm_sub_epi64(_mm_add_epi64(dns, ns), rns);
+
+        // keep the low 32 bits of each lane
+        _mm_storel_epi64((__m128i*)&out[i], _mm_shuffle_epi32(diff, _MM_SHUFFLE(2,0,2,0)));
+    }
+#endif
+    relativeNSScalar(out+i, in+i, count-i, refSec, refNS);
+}
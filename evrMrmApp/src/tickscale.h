@@ -0,0 +1,56 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+#ifndef TICKSCALE_H
+#define TICKSCALE_H
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+
+/** @brief Conversion of timestamp counter ticks to nanoseconds.
+ *
+ * Holds nanoseconds per tick as 32.32 fixed point, so conversion
+ * is two integer multiplies, and exact to within 2**-32 ns per tick.
+ * Computed once when the timestamp clock changes.
+ */
+struct TickScale
+{
+    epicsUInt64 mult; //!< ns per tick * 2**32.  0 when clock rate is not known.
+
+    TickScale() :mult(0u) {}
+
+    //! From timestamp clock rate in Hz
+    explicit TickScale(double hz)
+        :mult(0u)
+    {
+        double period = 1e9/hz; // in nanoseconds
+        // also excludes NaN and inf
+        if(period>0.0 && period<4294967296.0)
+            mult = epicsUInt64(period*4294967296.0 + 0.5);
+    }
+
+    bool valid() const { return mult!=0u; }
+
+    epicsUInt64 toNS(epicsUInt32 ticks) const
+    {
+        return epicsUInt64(ticks)*(mult>>32u)
+                + ((epicsUInt64(ticks)*(mult&0xffffffffu))>>32u);
+    }
+
+    /** @brief Bulk conversion to nanoseconds relative to a reference time
+     *
+     * in[] holds raw times as {POSIX seconds, ticks}.
+     * refSec and refNS are the reference as POSIX seconds and nanoseconds.
+     * Each result must fit in 32 bits (within about 2.1 sec. of the reference).
+     *
+     * Uses SIMD instructions where available.
+     */
+    void relativeNS(epicsInt32 *out, const epicsTimeStamp *in, size_t count,
+                    epicsUInt32 refSec, epicsUInt32 refNS) const;
+    //! Portable implementation of relativeNS()
+    void relativeNSScalar(epicsInt32 *out, const epicsTimeStamp *in, size_t count,
+                          epicsUInt32 refSec, epicsUInt32 refNS) const;
+};
+
+#endif // TICKSCALE_H
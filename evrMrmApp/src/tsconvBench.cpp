@@ -0,0 +1,103 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+/* Micro-benchmark of timestamp buffer conversion.
+ *
+ * Compares TickScale::relativeNS() with the portable version,
+ * and with the previous per-entry conversion through epicsTimeDiffInSeconds().
+ */
+
+#include <vector>
+
+#include <epicsTime.h>
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#include "tickscale.h"
+
+namespace {
+
+const double clockHz = 124.916e6;
+
+// spread over +-2 seconds around ref
+void fill(std::vector<epicsTimeStamp>& in, epicsUInt32 refSec)
+{
+    epicsUInt32 x = 12345u;
+    for(size_t i=0; i<in.size(); i++) {
+        x = x*1103515245u + 12345u; // LCG
+        in[i].secPastEpoch = refSec - 2u + (x>>30);
+        in[i].nsec = (x>>2)%epicsUInt32(clockHz);
+    }
+}
+
+void perEntry(const TickScale& scale, epicsInt32 *out, const epicsTimeStamp *in, size_t count,
+              const epicsTimeStamp& tref)
+{
+    for(size_t i=0; i<count; i++) {
+        epicsTimeStamp ts = in[i];
+        ts.secPastEpoch -= POSIX_TIME_AT_EPICS_EPOCH;
+        ts.nsec = epicsUInt32(scale.toNS(ts.nsec));
+        double diff = epicsTimeDiffInSeconds(&ts, &tref);
+        out[i] = epicsInt32(diff*1e9);
+    }
+}
+
+void bench(size_t count)
+{
+    testDiag("With %u entries", unsigned(count));
+    const TickScale scale(clockHz);
+    const epicsUInt32 refSec = 1500000000u, refNS = 123456789u;
+    epicsTimeStamp tref;
+    tref.secPastEpoch = refSec - POSIX_TIME_AT_EPICS_EPOCH;
+    tref.nsec = refNS;
+
+    std::vector<epicsTimeStamp> in(count);
+    std::vector<epicsInt32> bulk(count), scalar(count), old(count);
+    fill(in, refSec);
+
+    // repeat to total about 10M entries
+    const size_t reps = 10000000u/count;
+
+    const epicsTime T0(epicsTime::getCurrent());
+    for(size_t r=0; r<reps; r++)
+        scale.relativeNS(&bulk[0], &in[0], count, refSec, refNS);
+    const epicsTime T1(epicsTime::getCurrent());
+    for(size_t r=0; r<reps; r++)
+        scale.relativeNSScalar(&scalar[0], &in[0], count, refSec, refNS);
+    const epicsTime T2(epicsTime::getCurrent());
+    for(size_t r=0; r<reps; r++)
+        perEntry(scale, &old[0], &in[0], count, tref);
+    const epicsTime T3(epicsTime::getCurrent());
+
+    const double N = double(reps*count);
+    testDiag("relativeNS()       %.3f ns/entry", (T1-T0)*1e9/N);
+    testDiag("relativeNSScalar() %.3f ns/entry", (T2-T1)*1e9/N);
+    testDiag("per entry          %.3f ns/entry", (T3-T2)*1e9/N);
+
+    size_t mismatch = 0u, far = 0u;
+    for(size_t i=0; i<count; i++) {
+        if(bulk[i]!=scalar[i])
+            mismatch++;
+        // double conversion may round differently by 1ns
+        epicsInt32 diff = bulk[i]-old[i];
+        if(diff<-1 || diff>1)
+            far++;
+    }
+    testOk(mismatch==0u, "%u differ from portable", unsigned(mismatch));
+    testOk(far==0u, "%u differ from per entry", unsigned(far));
+}
+
+} // namespace
+
+MAIN(tsconvBench)
+{
+    testPlan(6);
+#if defined(__SSE2__)
+    testDiag("Using SSE2");
+#endif
+    bench(1000u);
+    bench(10000u);
+    bench(100000u);
+    return testDone();
+}
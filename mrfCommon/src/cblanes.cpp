@@ -0,0 +1,314 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#include <stdexcept>
+
+#include <stdio.h>
+
+#include <iocsh.h>
+#include <epicsInterrupt.h>
+#include <epicsAtomic.h>
+#include <epicsStdio.h>
+
+#include "mrfCommon.h"
+#define epicsExportSharedSymbols
+#include "mrf/cblanes.h"
+
+#include <epicsExport.h>
+
+namespace {
+
+mrf::CallbackLanes *theLanes;
+
+size_t checkDepth(unsigned depth)
+{
+    if(depth==0u)
+        throw std::invalid_argument("Lane depth must be positive");
+    return depth;
+}
+
+} // namespace
+
+namespace mrf {
+
+CallbackLane::CallbackLane(const std::string& name, unsigned depth, unsigned prio)
+    :mrf::ObjectInst<CallbackLane>(name)
+    ,jobs(checkDepth(depth))
+    ,head(0u)
+    ,count(0u)
+    ,nmax(0u)
+    ,noverflow(0u)
+    ,stop(0)
+    ,ndone(0u)
+    ,latSum(0.0)
+    ,latMax(0.0)
+    ,sched(name+":Sched")
+    ,worker(*this, name.c_str(),
+            epicsThreadGetStackSize(epicsThreadStackBig),
+            prio)
+{
+    worker.start();
+}
+
+CallbackLane::~CallbackLane()
+{
+    epicsAtomicSetIntT(&stop, 1);
+    wakeup.signal();
+    worker.exitWait();
+}
+
+bool CallbackLane::request(CALLBACK *cb)
+{
+    job_t J;
+    J.cb = cb;
+    // 0 if not measured
+    J.tqueue = 0u;
+    mrfLocalMonotonic(&J.tqueue);
+
+    bool ok;
+    int key = epicsInterruptLock();
+    ok = count<jobs.size();
+    if(ok) {
+        jobs[(head+count)%jobs.size()] = J;
+        count++;
+        if(count>nmax)
+            nmax = count;
+    } else {
+        noverflow++;
+    }
+    epicsInterruptUnlock(key);
+
+    if(ok)
+        wakeup.signal();
+    return ok;
+}
+
+void CallbackLane::run()
+{
+    sched.attach();
+
+    while(true) {
+        job_t J;
+        bool have;
+        {
+            int key = epicsInterruptLock();
+            have = count>0u;
+            if(have) {
+                J = jobs[head];
+                head = (head+1u)%jobs.size();
+                count--;
+            }
+            epicsInterruptUnlock(key);
+        }
+
+        if(!have) {
+            if(epicsAtomicGetIntT(&stop))
+                break;
+            wakeup.wait();
+            continue;
+        }
+
+        epicsUInt64 tstart = 0u;
+        if(J.tqueue)
+            mrfLocalMonotonic(&tstart);
+
+        (*J.cb->callback)(J.cb);
+
+        SCOPED_LOCK(mutex);
+        ndone++;
+        if(tstart>=J.tqueue && J.tqueue) {
+            double lat = (tstart-J.tqueue)*1e-3; // us
+            latSum += lat;
+            if(lat>latMax)
+                latMax = lat;
+        }
+    }
+
+    sched.detach();
+}
+
+epicsUInt32 CallbackLane::depth() const
+{
+    int key = epicsInterruptLock();
+    epicsUInt32 ret = count;
+    epicsInterruptUnlock(key);
+    return ret;
+}
+
+epicsUInt32 CallbackLane::depthMax() const
+{
+    int key = epicsInterruptLock();
+    epicsUInt32 ret = nmax;
+    epicsInterruptUnlock(key);
+    return ret;
+}
+
+epicsUInt32 CallbackLane::overflows() const
+{
+    int key = epicsInterruptLock();
+    epicsUInt32 ret = noverflow;
+    epicsInterruptUnlock(key);
+    return ret;
+}
+
+epicsUInt32 CallbackLane::completed() const
+{
+    SCOPED_LOCK(mutex);
+    return ndone;
+}
+
+double CallbackLane::latencyMean() const
+{
+    SCOPED_LOCK(mutex);
+    return ndone ? latSum/ndone : 0.0;
+}
+
+double CallbackLane::latencyMax() const
+{
+    SCOPED_LOCK(mutex);
+    return latMax;
+}
+
+void CallbackLane::reset()
+{
+    {
+        int key = epicsInterruptLock();
+        nmax = count;
+        noverflow = 0u;
+        epicsInterruptUnlock(key);
+    }
+    SCOPED_LOCK(mutex);
+    ndone = 0u;
+    latSum = latMax = 0.0;
+}
+
+CallbackLanes::CallbackLanes(unsigned count, unsigned depth, unsigned prio)
+{
+    if(count==0u)
+        throw std::invalid_argument("Must have at least one lane");
+    try {
+        lanes.reserve(count);
+        for(unsigned i=0; i<count; i++)
+            lanes.push_back(new CallbackLane(SB()<<"CBLane"<<i, depth, prio));
+    } catch(...) {
+        for(size_t i=0; i<lanes.size(); i++)
+            delete lanes[i];
+        throw;
+    }
+}
+
+CallbackLanes::~CallbackLanes()
+{
+    for(size_t i=0; i<lanes.size(); i++)
+        delete lanes[i];
+}
+
+CallbackLanes* CallbackLanes::active()
+{
+    return static_cast<CallbackLanes*>(epicsAtomicGetPtrT((EpicsAtomicPtrT*)&theLanes));
+}
+
+void CallbackLanes::create(unsigned count, unsigned depth, unsigned prio)
+{
+    if(active())
+        throw std::logic_error("Callback lanes already created");
+    CallbackLanes *lanes = new CallbackLanes(count, depth, prio);
+    epicsAtomicSetPtrT((EpicsAtomicPtrT*)&theLanes, lanes);
+}
+
+void laneRequest(CALLBACK *cb)
+{
+    CallbackLanes *lanes = CallbackLanes::active();
+    if(!lanes || !lanes->request(cb, cb->priority))
+        callbackRequest(cb);
+}
+
+} // namespace mrf
+
+using mrf::CallbackLane;
+
+OBJECT_BEGIN(CallbackLane) {
+    OBJECT_PROP1("Depth", &CallbackLane::depth);
+    OBJECT_PROP1("Depth Max", &CallbackLane::depthMax);
+    OBJECT_PROP1("Overflows", &CallbackLane::overflows);
+    OBJECT_PROP1("Completed", &CallbackLane::completed);
+    OBJECT_PROP1("Latency Mean", &CallbackLane::latencyMean);
+    OBJECT_PROP1("Latency Max", &CallbackLane::latencyMax);
+    OBJECT_PROP1("Reset", &CallbackLane::reset);
+} OBJECT_END(CallbackLane)
+
+/**
+ * Run mrfioc2 callbacks in dedicated threads instead of the shared EPICS callback queues.
+ * Must be called before iocInit.
+ @code
+   > mrfCallbackLanes(2, 90, 1024)
+ @endcode
+ *
+ @param count Number of lanes (threads)
+ @param prio EPICS thread priority of lanes (0-99)
+ @param depth Queue length of each lane.  When full, the EPICS callback queues are used.
+ */
+static
+void mrfCallbackLanes(int count, int prio, int depth)
+{
+try {
+    if(count<=0)
+        throw std::runtime_error("count must be >0");
+    if(prio<0 || prio>99)
+        throw std::runtime_error("prio must be in range [0, 99]");
+    if(depth<=0)
+        depth = 1024;
+    mrf::CallbackLanes::create(count, depth, prio);
+
+} catch(std::exception& e) {
+    printf("Error: %s\n", e.what());
+}
+}
+
+static void mrfCallbackLanesReport()
+{
+    mrf::CallbackLanes *lanes = mrf::CallbackLanes::active();
+    if(!lanes) {
+        printf("Using EPICS callback queues\n");
+        return;
+    }
+    printf("Lane      Depth  Max  Overflows   Completed  Lat.Mean(us)  Lat.Max(us)\n");
+    for(size_t i=0; i<lanes->size(); i++) {
+        CallbackLane& L = (*lanes)[i];
+        printf("%-8s %6u %4u %10u %11u  %12.1f %12.1f\n", L.name().c_str(),
+               (unsigned)L.depth(), (unsigned)L.depthMax(), (unsigned)L.overflows(),
+               (unsigned)L.completed(), L.latencyMean(), L.latencyMax());
+    }
+}
+
+static const iocshArg mrfCallbackLanesArg0 = { "count",iocshArgInt};
+static const iocshArg mrfCallbackLanesArg1 = { "EPICS priority",iocshArgInt};
+static const iocshArg mrfCallbackLanesArg2 = { "depth",iocshArgInt};
+static const iocshArg * const mrfCallbackLanesArgs[3] =
+    {&mrfCallbackLanesArg0,&mrfCallbackLanesArg1,&mrfCallbackLanesArg2};
+static const iocshFuncDef mrfCallbackLanesFuncDef =
+    {"mrfCallbackLanes",3,mrfCallbackLanesArgs};
+
+static void mrfCallbackLanesCall(const iocshArgBuf *args)
+{
+    mrfCallbackLanes(args[0].ival, args[1].ival, args[2].ival);
+}
+
+static const iocshFuncDef mrfCallbackLanesReportFuncDef =
+    {"mrfCallbackLanesReport",0,0};
+
+static void mrfCallbackLanesReportCall(const iocshArgBuf *)
+{
+    mrfCallbackLanesReport();
+}
+
+static void registrarCallbackLanes()
+{
+    iocshRegister(&mrfCallbackLanesFuncDef, &mrfCallbackLanesCall);
+    iocshRegister(&mrfCallbackLanesReportFuncDef, &mrfCallbackLanesReportCall);
+}
+extern "C" {
+epicsExportRegistrar(registrarCallbackLanes);
+}
@@ -0,0 +1,113 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+#ifndef MRF_CBLANES_H
+#define MRF_CBLANES_H
+
+#include <string>
+#include <vector>
+
+#include <epicsTypes.h>
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <callback.h>
+
+#include "mrf/object.h"
+#include "mrf/threadsched.h"
+
+namespace mrf {
+
+/** @brief A worker thread running CALLBACKs for mrfioc2 only.
+ *
+ * Used in place of the shared EPICS callback queues so that
+ * timing work is not queued behind unrelated callbacks.
+ * Named "CBLane<N>" with properties giving queue depth and latency.
+ * Thread scheduling is controlled through "CBLane<N>:Sched".
+ */
+class epicsShareClass CallbackLane : public mrf::ObjectInst<CallbackLane>,
+                                     protected epicsThreadRunable
+{
+    struct job_t {
+        CALLBACK *cb;
+        epicsUInt64 tqueue; // local monotonic ns.  0 if not measured
+    };
+
+    // Guarded by epicsInterruptLock() so request() may be called from an ISR
+    std::vector<job_t> jobs;
+    size_t head, count;
+    epicsUInt32 nmax, noverflow;
+    int stop;
+
+    // statistics guarded by mutex
+    mutable epicsMutex mutex;
+    epicsUInt32 ndone;
+    double latSum, latMax;
+
+    epicsEvent wakeup;
+    ThreadSched sched;
+    epicsThread worker;
+
+    virtual void run();
+public:
+    CallbackLane(const std::string& name, unsigned depth, unsigned prio);
+    virtual ~CallbackLane();
+
+    virtual void lock() const OVERRIDE FINAL { mutex.lock(); }
+    virtual void unlock() const OVERRIDE FINAL { mutex.unlock(); }
+
+    //! Queue cb to be run.  false if queue is full.  Safe to call from an ISR
+    bool request(CALLBACK *cb);
+
+    //! Currently queued
+    epicsUInt32 depth() const;
+    //! Most queued at once since reset()
+    epicsUInt32 depthMax() const;
+    //! Requests rejected since reset()
+    epicsUInt32 overflows() const;
+    //! Completed since reset()
+    epicsUInt32 completed() const;
+    //! Time from request() to start of run (us) since reset()
+    double latencyMean() const;
+    double latencyMax() const;
+    void reset();
+};
+
+/** @brief Set of CallbackLane
+ *
+ * Created once by the iocsh function mrfCallbackLanes().
+ * When not created, mrfioc2 uses the EPICS callback queues as before.
+ */
+class epicsShareClass CallbackLanes
+{
+    std::vector<CallbackLane*> lanes;
+
+    CallbackLanes(const CallbackLanes&);
+    CallbackLanes& operator=(const CallbackLanes&);
+public:
+    CallbackLanes(unsigned count, unsigned depth, unsigned prio);
+    ~CallbackLanes();
+
+    size_t size() const { return lanes.size(); }
+    CallbackLane& operator[](size_t i) { return *lanes[i]; }
+
+    //! Queue to the lane selected by key.  Requests with the same key run in order.
+    bool request(CALLBACK *cb, unsigned key) { return lanes[key%lanes.size()]->request(cb); }
+
+    //! Lanes created by mrfCallbackLanes(), or NULL
+    static CallbackLanes* active();
+    //! Create lanes.  Only once, before iocInit.
+    static void create(unsigned count, unsigned depth, unsigned prio);
+};
+
+/** @brief Queue cb to an mrfioc2 lane, or an EPICS callback queue
+ *
+ * Lane is selected by cb priority.
+ * Falls back to callbackRequest() when no lanes are created or the lane is full.
+ */
+epicsShareFunc void laneRequest(CALLBACK *cb);
+
+} // namespace mrf
+
+#endif // MRF_CBLANES_H
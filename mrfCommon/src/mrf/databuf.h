@@ -17,6 +17,8 @@
 #ifndef DATABUF_H_INC
 #define DATABUF_H_INC
 
+#include <stdexcept>
+
 #include <epicsTypes.h>
 #include <epicsTime.h>
 
@@ -55,6 +57,35 @@ public:
      */
     virtual void dataSend(epicsUInt32 len, const epicsUInt8 *buf)=0;
 
+    /**@brief Queue a byte array for transmission, without waiting
+     *
+     * If coalesce is non-zero, a queued buffer, not yet sent, which was queued with
+     * the same coalesce width and has the same Protocol ID (first coalesce bytes)
+     * is replaced.  Its completion function is then called with 'ok' 1.
+     * If given, fptr is called after buf is sent with 'ok' zero,
+     * or on error with 'ok' non-zero and 'buf' NULL.
+     * fptr may be called before dataSendAsync() returns.
+     * By default, the same as dataSend().
+     *
+     *@param len Number of bytes to send
+     *@param buf[in] Pointer to byte array to be sent.  Copied.
+     *@param fptr[in] Completion function, or NULL
+     *@param arg[in] Arbitrary pointer passed to completion function
+     *@param coalesce Length of Protocol ID in bytes (1, 2 or 4) to replace a queued buffer.
+     *                0 to never replace.
+     *@returns false if the queue is full, so buf was not queued
+     */
+    virtual bool dataSendAsync(epicsUInt32 len, const epicsUInt8 *buf,
+                               dataBufComplete fptr=0, void* arg=0,
+                               unsigned coalesce=0u)
+    {
+        (void)coalesce;
+        dataSend(len, buf);
+        if(fptr)
+            (*fptr)(arg, 0, len, buf);
+        return true;
+    }
+
 };
 
 
@@ -88,6 +119,72 @@ public:
     /**@brief Unregister
      */
     virtual void dataRxDeleteReceive(dataBufComplete fptr, void* arg=0)=0;
+
+    /**@brief Register to receive only buffers with a Protocol ID
+     *
+     * The Protocol ID is the first 1, 2 or 4 bytes of a buffer, in network byte order.
+     * Receivers may use this to dispatch by table lookup.
+     * By default, the same as dataRxAddReceive() so that fptr must also check the ID.
+     *
+     *@param width Length of Protocol ID in bytes.  1, 2 or 4
+     *@param id Protocol ID
+     *@param fptr[in] Function pointer invoked after Rx
+     *@param arg[in] Arbitrary pointer passed to completion function
+     */
+    virtual void dataRxAddReceiveProto(unsigned width, epicsUInt32 id, dataBufComplete fptr, void* arg=0)
+    { (void)width; (void)id; dataRxAddReceive(fptr, arg); }
+
+    /**@brief Unregister from dataRxAddReceiveProto()
+     */
+    virtual void dataRxDeleteReceiveProto(unsigned width, epicsUInt32 id, dataBufComplete fptr, void* arg=0)
+    { (void)width; (void)id; dataRxDeleteReceive(fptr, arg); }
+
+    /**@brief Number of segments of a segmented data buffer
+     *
+     * 0 if the receiver has no segmented data buffer.
+     */
+    virtual unsigned dataRxSegments() const { return 0u; }
+
+    //! Bytes in each segment of a segmented data buffer
+    virtual unsigned dataRxSegmentSize() const { return 0u; }
+
+    /**@brief Register to receive some segments of a segmented data buffer
+     *
+     * fptr is called when any of the segments [first, first+count) are updated,
+     * with 'buf' pointing to all of them.
+     * 'buf' is only valid while fptr runs, which must not (un)register.
+     * On a checksum error fptr is called with 'ok' non-zero and 'buf' NULL.
+     *
+     *@param first Index of first segment
+     *@param count Number of segments.  At least 1.
+     *@param fptr[in] Function pointer invoked after Rx
+     *@param arg[in] Arbitrary pointer passed to completion function
+     */
+    virtual void dataRxAddReceiveSegment(unsigned first, unsigned count, dataBufComplete fptr, void* arg=0)
+    {
+        (void)first; (void)count; (void)fptr; (void)arg;
+        throw std::logic_error("Segmented data buffer not supported");
+    }
+
+    /**@brief Unregister from dataRxAddReceiveSegment()
+     */
+    virtual void dataRxDeleteReceiveSegment(unsigned first, unsigned count, dataBufComplete fptr, void* arg=0)
+    { (void)first; (void)count; (void)fptr; (void)arg; }
+
+    /**@brief Keep a received buffer from being reused after the dataBufComplete callback returns
+     *
+     * Only valid for a 'buf' passed to a dataBufComplete callback, while that callback runs
+     * or while 'buf' is already held.
+     * Each successful call must be matched by a call to dataRxRelease().
+     * Held buffers are not available for reception, so should be released promptly.
+     *
+     *@returns false if not supported.  Then 'buf' must be copied.
+     */
+    virtual bool dataRxHold(const epicsUInt8* buf) { (void)buf; return false; }
+
+    /**@brief Release a buffer held with dataRxHold()
+     */
+    virtual void dataRxRelease(const epicsUInt8* buf) { (void)buf; }
 };
 
 #endif // DATABUF_H_INC
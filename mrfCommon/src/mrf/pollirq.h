@@ -6,25 +6,54 @@
 #include <epicsMutex.h>
 #include <shareLib.h>
 
+namespace mrf {
+class ThreadSched;
+}
+
 extern "C" {
     typedef void (*pollerFN)(void *);
+    //! Busy poll function.  Returns non-zero when work was found.
+    typedef int (*busyPollerFN)(void *);
 }
 
 class epicsShareClass IRQPoller : protected epicsThreadRunable {
+public:
+    //! Configuration of a busy polling thread
+    struct Options {
+        //! Sleep between polls when idle (sec)
+        double period;
+        /** Keep polling without sleep for this long after work was last found (sec).
+         *  <0 to never sleep, 0 to sleep whenever a poll finds no work.
+         */
+        double spin;
 
+        Options() :period(0.001), spin(0.0) {}
+    };
+
+private:
     epicsEvent evt;
     epicsMutex lock;
-    bool done;
+    int done;
     const double period;
 
     const pollerFN fn;
+    const busyPollerFN busyfn;
     void * const arg;
+    const Options opts;
+    mrf::ThreadSched * const sched;
 
     epicsThread runner;
 
     virtual void run();
+    void runBusy();
 public:
-    IRQPoller(pollerFN fn, void *arg, double period);
+    //! Call fn every period seconds.  If given, sched is attached by the polling thread.
+    IRQPoller(pollerFN fn, void *arg, double period, mrf::ThreadSched *sched = 0);
+    /** Call fn continuously, sleeping only when idle as configured.
+     *  If given, sched (CPU affinity and priority) is attached by the polling thread.
+     */
+    IRQPoller(busyPollerFN fn, void *arg, const Options& opts, const char *name = "IRQPoller",
+              mrf::ThreadSched *sched = 0);
     virtual ~IRQPoller();
 
 private:
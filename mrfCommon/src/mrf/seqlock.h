@@ -0,0 +1,61 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+#ifndef MRF_SEQLOCK_H
+#define MRF_SEQLOCK_H
+
+#include <epicsAtomic.h>
+#include <epicsThread.h>
+
+namespace mrf {
+
+/** @brief A value with one writer and many lock-free readers.
+ *
+ * A sequence counter is made odd while store() is in progress.
+ * load() retries until it sees the same even count before and after
+ * copying.  Readers never block the writer.
+ *
+ * T must be a plain, trivially copyable type.
+ * Concurrent calls to store() must be serialized by the caller.
+ */
+template<typename T>
+class SeqLock
+{
+    size_t seq;
+    T value;
+public:
+    SeqLock() :seq(0u), value() {}
+    explicit SeqLock(const T& v) :seq(0u), value(v) {}
+
+    void store(const T& v)
+    {
+        const size_t S = seq;
+        epicsAtomicSetSizeT(&seq, S+1u);
+        epicsAtomicWriteMemoryBarrier();
+        value = v;
+        epicsAtomicWriteMemoryBarrier();
+        epicsAtomicSetSizeT(&seq, S+2u);
+    }
+
+    T load() const
+    {
+        for(unsigned tries=0u; true; tries++) {
+            const size_t S = epicsAtomicGetSizeT(&seq);
+            if(!(S&1u)) {
+                epicsAtomicReadMemoryBarrier();
+                T ret(value);
+                epicsAtomicReadMemoryBarrier();
+                if(epicsAtomicGetSizeT(&seq)==S)
+                    return ret;
+            }
+            // writer was preempted mid-update.  Let it run.
+            if(tries>=16u)
+                epicsThreadSleep(0.0);
+        }
+    }
+};
+
+} // namespace mrf
+
+#endif // MRF_SEQLOCK_H
@@ -0,0 +1,95 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+#ifndef MRF_SMALLVECTOR_H
+#define MRF_SMALLVECTOR_H
+
+#include <stddef.h>
+
+namespace mrf {
+
+/** @brief Contiguous array with storage for N elements inline.
+ *
+ * Elements are kept in the object itself until more than N are added,
+ * when all move to a heap allocation.  So short lists can be walked
+ * without following any pointer to a separate allocation.
+ *
+ * T must be a plain, trivially copyable type.  Order of elements is preserved.
+ * Not copyable.  Not thread safe.
+ */
+template<typename T, size_t N>
+class SmallVector
+{
+    size_t count, cap;
+    T *elems; // either local or heap
+    T local[N];
+
+    SmallVector(const SmallVector&);
+    SmallVector& operator=(const SmallVector&);
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    SmallVector() :count(0u), cap(N), elems(local) {}
+    ~SmallVector()
+    {
+        if(elems!=local)
+            delete[] elems;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count==0u; }
+    size_t capacity() const { return cap; }
+
+    iterator begin() { return elems; }
+    iterator end() { return elems+count; }
+    const_iterator begin() const { return elems; }
+    const_iterator end() const { return elems+count; }
+
+    T& operator[](size_t i) { return elems[i]; }
+    const T& operator[](size_t i) const { return elems[i]; }
+
+    void push_back(const T& v)
+    {
+        if(count==cap) {
+            T *next = new T[2u*cap];
+            for(size_t i=0; i<count; i++)
+                next[i] = elems[i];
+            if(elems!=local)
+                delete[] elems;
+            elems = next;
+            cap *= 2u;
+        }
+        elems[count++] = v;
+    }
+
+    bool contains(const T& v) const
+    {
+        for(size_t i=0; i<count; i++) {
+            if(elems[i]==v)
+                return true;
+        }
+        return false;
+    }
+
+    //! Remove all elements equal to v.  Returns number removed.
+    size_t remove(const T& v)
+    {
+        size_t out=0u;
+        for(size_t in=0; in<count; in++) {
+            if(!(elems[in]==v))
+                elems[out++] = elems[in];
+        }
+        size_t ret = count-out;
+        count = out;
+        return ret;
+    }
+
+    void clear() { count = 0u; }
+};
+
+} // namespace mrf
+
+#endif // MRF_SMALLVECTOR_H
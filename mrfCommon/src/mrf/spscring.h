@@ -0,0 +1,97 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+#ifndef MRF_SPSCRING_H
+#define MRF_SPSCRING_H
+
+#include <vector>
+
+#include <epicsAtomic.h>
+
+namespace mrf {
+
+/** @brief Bounded single producer, single consumer queue.
+ *
+ * Lock-free.  At any time at most one thread may call push(),
+ * and at most one thread may call pop().  May be the same thread.
+ *
+ * Capacity is rounded up to a power of 2.  head and tail are free
+ * running counters which are only ever written by one side.
+ */
+template<typename T>
+class SPSCRing
+{
+    std::vector<T> store;
+    size_t mask;
+
+    // keep producer and consumer indicies on different cache lines
+    char pad0[64];
+    size_t head; // written by producer
+    char pad1[64];
+    size_t tail; // written by consumer
+    char pad2[64];
+
+    static size_t roundup(size_t n)
+    {
+        size_t ret = 2u;
+        while(ret<n)
+            ret<<=1;
+        return ret;
+    }
+
+    SPSCRing(const SPSCRing&);
+    SPSCRing& operator=(const SPSCRing&);
+public:
+    explicit SPSCRing(size_t cap)
+        :store(roundup(cap))
+        ,mask(store.size()-1u)
+        ,head(0u)
+        ,tail(0u)
+    {}
+
+    size_t capacity() const { return store.size(); }
+
+    //! Number of queued entries.  Only exact when called by producer or consumer.
+    size_t size() const
+    {
+        return epicsAtomicGetSizeT(const_cast<size_t*>(&head))
+                - epicsAtomicGetSizeT(const_cast<size_t*>(&tail));
+    }
+    bool empty() const { return size()==0u; }
+
+    //! Producer.  Returns false if full.
+    bool push(const T& v)
+    {
+        const size_t H = head;
+        if(H - epicsAtomicGetSizeT(&tail) >= store.size())
+            return false;
+
+        store[H&mask] = v;
+        // entry must be visible before the new head
+        epicsAtomicWriteMemoryBarrier();
+        epicsAtomicSetSizeT(&head, H+1u);
+        return true;
+    }
+
+    //! Consumer.  Returns false if empty.
+    bool pop(T& v)
+    {
+        const size_t T0 = tail;
+        if(epicsAtomicGetSizeT(&head)==T0)
+            return false;
+        // don't read entry before head
+        epicsAtomicReadMemoryBarrier();
+
+        v = store[T0&mask];
+        // entry must be copied out before producer may overwrite
+        epicsAtomicReadMemoryBarrier();
+        epicsAtomicWriteMemoryBarrier();
+        epicsAtomicSetSizeT(&tail, T0+1u);
+        return true;
+    }
+};
+
+} // namespace mrf
+
+#endif // MRF_SPSCRING_H
@@ -0,0 +1,72 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+#ifndef MRF_THREADSCHED_H
+#define MRF_THREADSCHED_H
+
+#include <string>
+#include <vector>
+
+#include <epicsTypes.h>
+#include <epicsMutex.h>
+
+#include "mrf/object.h"
+
+namespace mrf {
+
+/** @brief CPU affinity and real-time priority of one driver thread.
+ *
+ * Each thread with a latency sensitive role owns one of these,
+ * named eg. "EVR1:Sched:FIFO".
+ * The thread calls attach() when it starts, and detach() before it exits.
+ * Settings made before attach() are applied then.  Later settings are applied immediately.
+ * A thread is left as inherited (eg. from taskset) until CPUs or a priority are set,
+ * and returned to that when they are cleared.
+ *
+ * Only effective on Linux.  Elsewhere settings are stored, but have no effect.
+ */
+class epicsShareClass ThreadSched : public mrf::ObjectInst<ThreadSched>
+{
+    mutable epicsMutex mutex;
+    std::string cpuList;
+    epicsUInt32 prio;
+    // OS thread ID while attached, otherwise 0
+    long tid;
+    // scheduling before attach(), restored when priority is set to 0
+    int origPolicy, origPrio;
+    // affinity before attach(), restored when CPUs are cleared
+    std::vector<bool> origCPUs;
+    // whether apply() has changed affinity/scheduling from the original
+    bool cpusApplied, prioApplied;
+
+    void apply();
+public:
+    explicit ThreadSched(const std::string& n);
+    virtual ~ThreadSched();
+
+    virtual void lock() const OVERRIDE FINAL { mutex.lock(); }
+    virtual void unlock() const OVERRIDE FINAL { mutex.unlock(); }
+
+    //! Call from the thread being controlled
+    void attach();
+    void detach();
+
+    //! CPU list, eg. "2,4-7".  Empty to allow all CPUs.
+    std::string CPUs() const;
+    void setCPUs(std::string cpus);
+
+    //! SCHED_FIFO priority 1-99.  0 for the normal EPICS thread priority
+    epicsUInt32 priority() const;
+    void setPriority(epicsUInt32 p);
+
+    //! Actual scheduling of the thread, as read back from the OS
+    std::string state() const;
+
+    //! Print state() of all ThreadSched instances
+    static void report();
+};
+
+} // namespace mrf
+
+#endif // MRF_THREADSCHED_H
@@ -5,7 +5,12 @@
 #include <limits.h>
 #include <stdlib.h>
 
+#if defined(__linux__)
+#  include <time.h>
+#endif
+
 #include <epicsStdio.h>
+#include <epicsTime.h>
 #include <epicsExport.h>
 #include "mrfCommon.h"
 
@@ -74,6 +79,24 @@ char *allocSNPrintf(size_t N, const char *fmt, ...)
     return mem;
 }
 
+bool mrfLocalMonotonic(epicsUInt64 *ns)
+{
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_RAW)
+    struct timespec now;
+    if(clock_gettime(CLOCK_MONOTONIC_RAW, &now)==0) {
+        *ns = epicsUInt64(now.tv_sec)*1000000000u + now.tv_nsec;
+        return true;
+    }
+#endif
+#if EPICS_VERSION_INT>=VERSION_INT(7,0,1,0)
+    *ns = epicsMonotonicGet();
+    return true;
+#else
+    (void)ns;
+    return false;
+#endif
+}
+
 #if (EPICS_VERSION_INT < VERSION_INT(3,15,0,2))
 
 static
@@ -333,6 +333,12 @@ public:
 epicsShareFunc epicsUInt32 roundToUInt(double val, epicsUInt32 maxresult=0xffffffff);
 
 epicsShareFunc char *allocSNPrintf(size_t N, const char *fmt, ...) EPICS_PRINTF_STYLE(2,3);
+
+/* Local monotonic clock in nanoseconds, for measuring intervals.
+ * Prefers a clock which is not slewed by NTP.
+ * Returns false if no monotonic clock is available.
+ */
+epicsShareFunc bool mrfLocalMonotonic(epicsUInt64 *ns);
 #endif
 
 /**************************************************************************************************/
@@ -1,16 +1,33 @@
 
+
 #include <epicsThread.h>
 #include <epicsEvent.h>
 #include <epicsMutex.h>
 #include <epicsGuard.h>
+#include <epicsAtomic.h>
+#include <errlog.h>
 #define epicsExportSharedSymbols
+#include "mrfCommon.h"
+#include "mrf/threadsched.h"
 #include "mrf/pollirq.h"
 
-IRQPoller::IRQPoller(pollerFN fn, void* arg, double period) :
-  done(false),
+namespace {
+// hint to the CPU that this is a spin loop
+inline void pollerRelax()
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    __asm__ __volatile__ ("pause");
+#endif
+}
+} // namespace
+
+IRQPoller::IRQPoller(pollerFN fn, void* arg, double period, mrf::ThreadSched *sched) :
+  done(0),
   period(period),
   fn(fn),
+  busyfn(0),
   arg(arg),
+  sched(sched),
   runner(*this, "IRQPoller",
         epicsThreadGetStackSize(epicsThreadStackBig),
         epicsThreadPriorityHigh)
@@ -18,25 +35,83 @@ IRQPoller::IRQPoller(pollerFN fn, void* arg, double period) :
     runner.start();
 }
 
+IRQPoller::IRQPoller(busyPollerFN fn, void* arg, const Options& opts, const char *name,
+                     mrf::ThreadSched *sched) :
+  done(0),
+  period(opts.period),
+  fn(0),
+  busyfn(fn),
+  arg(arg),
+  opts(opts),
+  sched(sched),
+  runner(*this, name,
+        epicsThreadGetStackSize(epicsThreadStackBig),
+        epicsThreadPriorityMax)
+{
+    runner.start();
+}
+
 IRQPoller::~IRQPoller()
 {
     {
         epicsGuard<epicsMutex> G(lock);
-        done = true;
+        epicsAtomicSetIntT(&done, 1);
     }
     runner.exitWait();
 }
 
 void IRQPoller::run()
 {
-    epicsGuard<epicsMutex> G(lock);
-    while(!done) {
-        double P = period;
-        {
-            epicsGuardRelease<epicsMutex> U(G);
-            epicsThreadSleep(P);
+    if(busyfn) {
+        runBusy();
+        return;
+    }
+
+    if(sched)
+        sched->attach();
+
+    {
+        epicsGuard<epicsMutex> G(lock);
+        while(!done) {
+            double P = period;
+            {
+                epicsGuardRelease<epicsMutex> U(G);
+                epicsThreadSleep(P);
+            }
+
+            (*fn)(arg);
+        }
+    }
+
+    if(sched)
+        sched->detach();
+}
+
+void IRQPoller::runBusy()
+{
+    if(sched)
+        sched->attach();
+
+    // Spinning for a time needs a monotonic clock.  Without one, sleep when idle.
+    epicsUInt64 lastWork = 0u;
+    const bool timed = opts.spin>0.0 && mrfLocalMonotonic(&lastWork);
+    const epicsUInt64 spinNS = timed ? epicsUInt64(opts.spin*1e9) : 0u;
+
+    while(!epicsAtomicGetIntT(&done)) {
+        if((*busyfn)(arg)) {
+            if(timed)
+                mrfLocalMonotonic(&lastWork);
+            continue;
         }
 
-        (*fn)(arg);
+        epicsUInt64 now = 0u;
+        if(opts.spin<0.0 || (timed && mrfLocalMonotonic(&now) && now-lastWork < spinNS)) {
+            pollerRelax();
+        } else {
+            epicsThreadSleep(period);
+        }
     }
+
+    if(sched)
+        sched->detach();
 }
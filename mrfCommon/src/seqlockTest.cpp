@@ -0,0 +1,82 @@
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#include "mrf/seqlock.h"
+
+namespace {
+using namespace mrf;
+
+// each update keeps a==~b, so a torn read is detectable
+struct pair_t {
+    unsigned a, b;
+};
+
+struct writer : public epicsThreadRunable
+{
+    SeqLock<pair_t>& val;
+    const unsigned count;
+    writer(SeqLock<pair_t>& val, unsigned count) :val(val), count(count) {}
+    virtual ~writer() {}
+    virtual void run()
+    {
+        for(unsigned i=1; i<=count; i++) {
+            pair_t P;
+            P.a = i;
+            P.b = ~i;
+            val.store(P);
+        }
+    }
+};
+
+void testBasic()
+{
+    testDiag("In testBasic()");
+    pair_t init = {1u, ~1u};
+    SeqLock<pair_t> val(init);
+
+    pair_t P = val.load();
+    testOk1(P.a==1u && P.b==~1u);
+
+    P.a = 2u;
+    P.b = ~2u;
+    val.store(P);
+    P = val.load();
+    testOk1(P.a==2u && P.b==~2u);
+}
+
+void testThreaded()
+{
+    testDiag("In testThreaded()");
+    pair_t init = {0u, ~0u};
+    SeqLock<pair_t> val(init);
+    writer W(val, 1000000u);
+
+    epicsThread thr(W, "writer", epicsThreadGetStackSize(epicsThreadStackSmall));
+    thr.start();
+
+    unsigned torn = 0u, backwards = 0u, prev = 0u;
+    while(prev<W.count) {
+        pair_t P = val.load();
+        if(P.a!=~P.b)
+            torn++;
+        if(P.a<prev)
+            backwards++;
+        prev = P.a;
+    }
+
+    thr.exitWait();
+    testOk(torn==0u, "%u torn reads", torn);
+    testOk(backwards==0u, "%u went backwards", backwards);
+}
+
+} // namespace
+
+MAIN(seqlockTest)
+{
+    testPlan(4);
+    testBasic();
+    testThreaded();
+    return testDone();
+}
@@ -0,0 +1,71 @@
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#include "mrf/smallvector.h"
+
+namespace {
+using namespace mrf;
+
+void testInline()
+{
+    testDiag("In testInline()");
+    SmallVector<int, 2> V;
+
+    testOk1(V.empty());
+    testOk1(V.capacity()==2u);
+
+    V.push_back(1);
+    V.push_back(2);
+    testOk1(V.size()==2u);
+    testOk1(V.capacity()==2u);
+    testOk1(V[0]==1 && V[1]==2);
+    testOk1(V.contains(2));
+    testOk1(!V.contains(3));
+}
+
+void testSpill()
+{
+    testDiag("In testSpill()");
+    SmallVector<int, 2> V;
+
+    for(int i=0; i<10; i++)
+        V.push_back(i);
+    testOk1(V.size()==10u);
+    testOk1(V.capacity()>=10u);
+
+    bool ok = true;
+    int expect = 0;
+    for(SmallVector<int, 2>::const_iterator it(V.begin()), end(V.end()); it!=end; ++it)
+        ok &= *it==expect++;
+    testOk(ok, "order preserved");
+}
+
+void testRemove()
+{
+    testDiag("In testRemove()");
+    SmallVector<int, 4> V;
+
+    V.push_back(1);
+    V.push_back(2);
+    V.push_back(1);
+    V.push_back(3);
+
+    testOk1(V.remove(1)==2u);
+    testOk1(V.size()==2u);
+    testOk1(V[0]==2 && V[1]==3);
+    testOk1(V.remove(4)==0u);
+
+    V.clear();
+    testOk1(V.empty());
+}
+
+} // namespace
+
+MAIN(smallvectorTest)
+{
+    testPlan(15);
+    testInline();
+    testSpill();
+    testRemove();
+    return testDone();
+}
@@ -0,0 +1,95 @@
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#include "mrf/spscring.h"
+
+namespace {
+using namespace mrf;
+
+void testBasic()
+{
+    testDiag("In testBasic()");
+    SPSCRing<int> ring(5);
+
+    testOk1(ring.capacity()==8u);
+    testOk1(ring.empty());
+
+    int v = -1;
+    testOk1(!ring.pop(v));
+
+    for(int i=0; i<8; i++)
+        ring.push(i);
+    testOk1(ring.size()==8u);
+    testOk1(!ring.push(8));
+
+    bool ok = true;
+    for(int i=0; i<8; i++)
+        ok &= ring.pop(v) && v==i;
+    testOk(ok, "FIFO order");
+    testOk1(ring.empty());
+
+    // wrap around many times
+    ok = true;
+    for(int i=0; i<100; i++) {
+        ok &= ring.push(i);
+        ok &= ring.push(-i);
+        ok &= ring.pop(v) && v==i;
+        ok &= ring.pop(v) && v==-i;
+    }
+    testOk(ok, "wrap around");
+}
+
+struct producer : public epicsThreadRunable
+{
+    SPSCRing<unsigned>& ring;
+    const unsigned count;
+    epicsEvent done;
+    producer(SPSCRing<unsigned>& ring, unsigned count) :ring(ring), count(count) {}
+    virtual ~producer() {}
+    virtual void run()
+    {
+        for(unsigned i=0; i<count; i++) {
+            while(!ring.push(i))
+                epicsThreadSleep(0.0);
+        }
+        done.signal();
+    }
+};
+
+void testThreaded()
+{
+    testDiag("In testThreaded()");
+    SPSCRing<unsigned> ring(64);
+    producer prod(ring, 1000000u);
+
+    epicsThread thr(prod, "producer", epicsThreadGetStackSize(epicsThreadStackSmall));
+    thr.start();
+
+    unsigned expect = 0u, bad = 0u;
+    while(expect<prod.count) {
+        unsigned v;
+        if(!ring.pop(v)) {
+            epicsThreadSleep(0.0);
+            continue;
+        }
+        if(v!=expect)
+            bad++;
+        expect++;
+    }
+
+    prod.done.wait();
+    testOk(bad==0u, "%u out of order", bad);
+    testOk1(ring.empty());
+}
+
+} // namespace
+
+MAIN(spscringTest)
+{
+    testPlan(10);
+    testBasic();
+    testThreaded();
+    return testDone();
+}
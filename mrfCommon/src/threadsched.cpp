@@ -0,0 +1,327 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#include <stdexcept>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__linux__)
+#  include <sched.h>
+#  include <unistd.h>
+#  include <sys/syscall.h>
+#  define HAVE_THREADSCHED
+#endif
+
+#include <iocsh.h>
+#include <errlog.h>
+#include <epicsStdio.h>
+
+#include "mrfCommon.h"
+#define epicsExportSharedSymbols
+#include "mrf/threadsched.h"
+
+#include <epicsExport.h>
+
+namespace {
+
+/* Parse CPU list "2,4-7" into flags.  Empty list gives no flags. */
+std::vector<bool> parseCPUs(const std::string& list)
+{
+    std::vector<bool> ret;
+    std::istringstream strm(list);
+    std::string part;
+
+    while(std::getline(strm, part, ',')) {
+        size_t start = part.find_first_not_of(" \t"), end = part.find_last_not_of(" \t");
+        if(start==std::string::npos)
+            continue;
+        part = part.substr(start, end-start+1u);
+        unsigned first=0, last=0;
+        char junk;
+        if(sscanf(part.c_str(), "%u-%u%c", &first, &last, &junk)==2) {
+        } else if(sscanf(part.c_str(), "%u%c", &first, &junk)==1) {
+            last = first;
+        } else {
+            throw std::invalid_argument(SB()<<"Invalid CPU list entry '"<<part<<"'");
+        }
+        if(first>last || last>=1024u)
+            throw std::invalid_argument(SB()<<"Invalid CPU range '"<<part<<"'");
+        if(ret.size()<=last)
+            ret.resize(last+1u, false);
+        for(unsigned i=first; i<=last; i++)
+            ret[i] = true;
+    }
+    return ret;
+}
+
+// format flags as a CPU list
+std::string formatCPUs(const std::vector<bool>& cpus)
+{
+    std::ostringstream strm;
+    bool first = true;
+    for(size_t i=0; i<cpus.size(); i++) {
+        if(!cpus[i])
+            continue;
+        size_t last = i;
+        while(last+1u<cpus.size() && cpus[last+1u])
+            last++;
+        if(!first)
+            strm<<',';
+        first = false;
+        strm<<i;
+        if(last>i)
+            strm<<'-'<<last;
+        i = last;
+    }
+    return strm.str();
+}
+
+} // namespace
+
+namespace mrf {
+
+ThreadSched::ThreadSched(const std::string& n)
+    :mrf::ObjectInst<ThreadSched>(n)
+    ,prio(0u)
+    ,tid(0)
+    ,origPolicy(0)
+    ,origPrio(0)
+    ,cpusApplied(false)
+    ,prioApplied(false)
+{}
+
+ThreadSched::~ThreadSched() {}
+
+void ThreadSched::attach()
+{
+    SCOPED_LOCK(mutex);
+#ifdef HAVE_THREADSCHED
+    tid = syscall(SYS_gettid);
+    origPolicy = sched_getscheduler(0);
+    struct sched_param param;
+    if(origPolicy<0 || sched_getparam(0, &param)) {
+        origPolicy = SCHED_OTHER;
+        origPrio = 0;
+    } else {
+        origPrio = param.sched_priority;
+    }
+    cpu_set_t set;
+    origCPUs.clear();
+    if(sched_getaffinity(0, sizeof(set), &set)==0) {
+        origCPUs.resize(CPU_SETSIZE, false);
+        for(unsigned i=0; i<CPU_SETSIZE; i++)
+            origCPUs[i] = CPU_ISSET(i, &set);
+    }
+    cpusApplied = prioApplied = false;
+    apply();
+#endif
+}
+
+void ThreadSched::detach()
+{
+    SCOPED_LOCK(mutex);
+    tid = 0;
+}
+
+std::string ThreadSched::CPUs() const
+{
+    SCOPED_LOCK(mutex);
+    return cpuList;
+}
+
+void ThreadSched::setCPUs(std::string cpus)
+{
+    // normalize.  eg. "1,2,3" -> "1-3"
+    std::string norm(formatCPUs(parseCPUs(cpus)));
+    SCOPED_LOCK(mutex);
+    cpuList = norm;
+    apply();
+}
+
+epicsUInt32 ThreadSched::priority() const
+{
+    SCOPED_LOCK(mutex);
+    return prio;
+}
+
+void ThreadSched::setPriority(epicsUInt32 p)
+{
+    if(p>99u)
+        throw std::invalid_argument("SCHED_FIFO priority must be in range [0, 99]");
+    SCOPED_LOCK(mutex);
+    prio = p;
+    apply();
+}
+
+// caller must hold mutex
+void ThreadSched::apply()
+{
+#ifdef HAVE_THREADSCHED
+    if(!tid)
+        return;
+
+    // leave the thread as inherited until configured
+    if(!cpuList.empty() || cpusApplied) {
+        // when cleared, restore the original
+        std::vector<bool> cpus(cpuList.empty() ? origCPUs : parseCPUs(cpuList));
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(size_t i=0; i<cpus.size() && i<CPU_SETSIZE; i++) {
+            if(cpus[i])
+                CPU_SET(i, &set);
+        }
+        if(sched_setaffinity(tid, sizeof(set), &set))
+            errlogPrintf("%s: Unable to set CPUs '%s' : %s\n", name().c_str(), cpuList.c_str(), strerror(errno));
+        else
+            cpusApplied = !cpuList.empty();
+    }
+
+    if(prio || prioApplied) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        int policy;
+        if(prio) {
+            policy = SCHED_FIFO;
+            param.sched_priority = prio;
+        } else {
+            policy = origPolicy;
+            param.sched_priority = origPrio;
+        }
+        if(sched_setscheduler(tid, policy, &param))
+            errlogPrintf("%s: Unable to set priority %u : %s\n", name().c_str(), (unsigned)prio, strerror(errno));
+        else
+            prioApplied = prio!=0;
+    }
+#endif
+}
+
+std::string ThreadSched::state() const
+{
+    SCOPED_LOCK(mutex);
+#ifdef HAVE_THREADSCHED
+    if(!tid)
+        return "Not running";
+
+    std::ostringstream strm;
+
+    int policy = sched_getscheduler(tid);
+    struct sched_param param;
+    if(policy<0 || sched_getparam(tid, &param)) {
+        strm<<"Error "<<errno;
+    } else {
+        switch(policy) {
+        case SCHED_FIFO: strm<<"FIFO "<<param.sched_priority; break;
+        case SCHED_RR: strm<<"RR "<<param.sched_priority; break;
+        case SCHED_OTHER: strm<<"OTHER"; break;
+        default: strm<<"Policy "<<policy; break;
+        }
+    }
+
+    cpu_set_t set;
+    if(sched_getaffinity(tid, sizeof(set), &set)==0) {
+        std::vector<bool> cpus(CPU_SETSIZE, false);
+        for(unsigned i=0; i<CPU_SETSIZE; i++)
+            cpus[i] = CPU_ISSET(i, &set);
+        strm<<" CPUs "<<formatCPUs(cpus);
+    }
+    return strm.str();
+#else
+    return "Not supported";
+#endif
+}
+
+static
+bool reportOne(mrf::Object* obj, void*)
+{
+    ThreadSched *sched = dynamic_cast<ThreadSched*>(obj);
+    if(sched) {
+        printf("%-24s CPUs: %-10s Priority: %-3u Actual: %s\n",
+               sched->name().c_str(),
+               sched->CPUs().empty() ? "any" : sched->CPUs().c_str(),
+               (unsigned)sched->priority(),
+               sched->state().c_str());
+    }
+    return true;
+}
+
+void ThreadSched::report()
+{
+    mrf::Object::visitObjects(&reportOne, 0);
+}
+
+} // namespace mrf
+
+using mrf::ThreadSched;
+
+OBJECT_BEGIN(ThreadSched) {
+    OBJECT_PROP2("CPUs", &ThreadSched::CPUs, &ThreadSched::setCPUs);
+    OBJECT_PROP2("Priority", &ThreadSched::priority, &ThreadSched::setPriority);
+    OBJECT_PROP1("State", &ThreadSched::state);
+} OBJECT_END(ThreadSched)
+
+/**
+ * Set CPU affinity and SCHED_FIFO priority of a driver thread.
+ @code
+   > mrfThreadSched("EVR1:Sched:FIFO", "2-3", 80)
+   > mrfThreadSched("EVR1:Sched:Dispatch", "", 0) # restore default
+ @endcode
+ *
+ @param name Thread scheduling object name.  See mrfThreadSchedReport()
+ @param cpus CPU list eg. "2,4-7".  Empty for all CPUs
+ @param priority SCHED_FIFO priority 1-99.  0 for default
+ */
+static
+void mrfThreadSched(const char *name, const char *cpus, int priority)
+{
+try {
+    if(!name)
+        throw std::runtime_error("Missing name");
+    mrf::ThreadSched *sched = dynamic_cast<mrf::ThreadSched*>(mrf::Object::getObject(name));
+    if(!sched)
+        throw std::runtime_error("Thread scheduling object not found");
+    if(priority<0)
+        throw std::runtime_error("priority must be >=0");
+
+    sched->setCPUs(cpus ? cpus : "");
+    sched->setPriority(priority);
+
+} catch(std::exception& e) {
+    printf("Error: %s\n", e.what());
+}
+}
+
+static const iocshArg mrfThreadSchedArg0 = { "name",iocshArgString};
+static const iocshArg mrfThreadSchedArg1 = { "CPU list",iocshArgString};
+static const iocshArg mrfThreadSchedArg2 = { "SCHED_FIFO priority (0 for default)",iocshArgInt};
+static const iocshArg * const mrfThreadSchedArgs[3] =
+    {&mrfThreadSchedArg0,&mrfThreadSchedArg1,&mrfThreadSchedArg2};
+static const iocshFuncDef mrfThreadSchedFuncDef =
+    {"mrfThreadSched",3,mrfThreadSchedArgs};
+
+static void mrfThreadSchedCall(const iocshArgBuf *args)
+{
+    mrfThreadSched(args[0].sval, args[1].sval, args[2].ival);
+}
+
+static const iocshFuncDef mrfThreadSchedReportFuncDef =
+    {"mrfThreadSchedReport",0,0};
+
+static void mrfThreadSchedReportCall(const iocshArgBuf *)
+{
+    mrf::ThreadSched::report();
+}
+
+static void registrarThreadSched()
+{
+    iocshRegister(&mrfThreadSchedFuncDef, &mrfThreadSchedCall);
+    iocshRegister(&mrfThreadSchedReportFuncDef, &mrfThreadSchedReportCall);
+}
+extern "C" {
+epicsExportRegistrar(registrarThreadSched);
+}
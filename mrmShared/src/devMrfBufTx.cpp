@@ -11,6 +11,7 @@
 #include <waveformRecord.h>
 #include <menuFtype.h>
 #include <epicsEndian.h>
+#include <callback.h>
 
 #ifdef _WIN32
  #include <Winsock2.h>
@@ -31,22 +32,46 @@
 
 
 #include <epicsExport.h>
+
+/**
+ * Note on record processing.
+ *
+ * Buffers are queued with dataSendAsync(), and the record completes
+ * asynchronously after the buffer has been sent.
+ */
+
 struct s_priv
 {
   char obj[40];
   epicsUInt32 proto;
   char prop[20];
+  // width of the leading protocol ID used to coalesce queued buffers (0 - never)
+  epicsUInt32 coalesce;
 
   dataBufTx *priv;
   epicsUInt8 *scratch;
+
+  // completion of dataSendAsync()
+  CALLBACK done_cb;
+  epicsStatus done_status;
 };
 
+static
+void txdone(void *arg, epicsStatus ok, epicsUInt32, const epicsUInt8*)
+{
+  waveformRecord* prec=(waveformRecord*)arg;
+  s_priv *paddr=static_cast<s_priv*>(prec->dpvt);
+  paddr->done_status=ok;
+  callbackRequestProcessCallback(&paddr->done_cb, priorityHigh, prec);
+}
+
 static const
 linkOptionDef eventdef[] =
 {
   linkString  (s_priv, obj , "OBJ"  , 1, 0),
   linkInt32   (s_priv, proto, "Proto", 1, 0),
   linkString  (s_priv, prop , "P", 1, 0),
+  linkInt32   (s_priv, coalesce, "Coalesce", 0, 0),
   linkOptionEnd
 };
 
@@ -58,10 +83,14 @@ try {
   assert(prec->inp.type==INST_IO);
 
   mrf::auto_ptr<s_priv> paddr(new s_priv);
+  paddr->coalesce=0;
 
   if (linkOptionsStore(eventdef, paddr.get(), prec->inp.value.instio.string, 0))
     throw std::runtime_error("Couldn't parse link string");
 
+  if(paddr->coalesce!=0 && paddr->coalesce!=1 && paddr->coalesce!=2 && paddr->coalesce!=4)
+    throw std::runtime_error("Coalesce must be 0, 1, 2, or 4");
+
   mrf::Object *O=mrf::Object::getObject(paddr->obj);
   if(!O) {
       errlogPrintf("%s: failed to find object '%s'\n", prec->name, paddr->obj);
@@ -119,6 +148,15 @@ static long write_waveform(waveformRecord* prec)
 try {
   s_priv *paddr=static_cast<s_priv*>(prec->dpvt);
 
+  if (prec->pact) {
+      // completion
+      if (paddr->done_status==1)
+          (void)recGblSetSevr(prec, WRITE_ALARM, MINOR_ALARM); // superseded
+      else if (paddr->done_status)
+          (void)recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
+      return 0;
+  }
+
   epicsUInt32 capacity=paddr->priv->lenMax();
   const long esize=dbValueSize(prec->ftvl);
   epicsUInt32 requested=prec->nord*esize;
@@ -152,7 +190,12 @@ try {
       }
   }
 
-  paddr->priv->dataSend(requested,buf);
+  if (!paddr->priv->dataSendAsync(requested, buf, txdone, prec, paddr->coalesce)) {
+      // queue full
+      (void)recGblSetSevr(prec, WRITE_ALARM, INVALID_ALARM);
+      return 0;
+  }
+  prec->pact = TRUE;
 
   return 0;
 } catch(std::exception& e) {
@@ -6,13 +6,16 @@
 * in file LICENSE that is included with this distribution.
 \*************************************************************************/
 #include <cstdio>
+#include <cstring>
 #include <stdexcept>
 
 #include <epicsTypes.h>
 
 #include <epicsThread.h>
 #include <epicsInterrupt.h>
+#include <errlog.h>
 
+#include <mrfCommon.h>
 #include <mrfCommonIO.h>
 
 #include "mrf/databuf.h"
@@ -29,18 +32,61 @@
 #define DataTxCtrl_len_mask 0x0007fc
 #define DataTxCtrl_len_max  DataTxCtrl_len_mask
 
+namespace {
+unsigned checkDepth(unsigned depth)
+{
+    if(depth==0u)
+        throw std::invalid_argument("Tx queue depth must be positive");
+    return depth;
+}
+} // namespace
+
 mrmDataBufTx::mrmDataBufTx(const std::string& n,
                  volatile epicsUInt8* bufcontrol,
-                 volatile epicsUInt8* buffer
-) :dataBufTx(n)
+                 volatile epicsUInt8* buffer,
+                 unsigned qdepth
+) :base_t(n)
   ,dataCtrl(bufcontrol)
   ,dataBuf(buffer)
   ,dataGuard()
+  ,slots(checkDepth(qdepth))
+  ,running(false)
+  ,stop(false)
+  ,nmax(0u)
+  ,nsent(0u)
+  ,ncoalesced(0u)
+  ,ndropped(0u)
+  ,latSum(0.0)
+  ,latMax(0.0)
+  ,sched(n+":Sched")
+  ,worker(*this, n.c_str(),
+          epicsThreadGetStackSize(epicsThreadStackSmall),
+          epicsThreadPriorityHigh)
 {
+    scanIoInit(&sentScan);
+
+    freeslots.reserve(slots.size());
+    for(size_t i=0; i<slots.size(); i++) {
+        slots[i] = new slot;
+        slots[i]->data.resize(DataTxCtrl_len_max);
+        freeslots.push_back(slots[i]);
+    }
 }
 
 mrmDataBufTx::~mrmDataBufTx()
 {
+    bool wait;
+    {
+        SCOPED_LOCK(txGuard);
+        stop = true;
+        wait = running;
+    }
+    if(wait) {
+        wakeup.signal();
+        worker.exitWait();
+    }
+    for(size_t i=0; i<slots.size(); i++)
+        delete slots[i];
 }
 
 bool
@@ -101,6 +147,12 @@ mrmDataBufTx::dataSend(epicsUInt32 len,
 
     SCOPED_LOCK(dataGuard);
 
+    sendNow(len, ubuf);
+}
+
+void
+mrmDataBufTx::sendNow(epicsUInt32 len, const epicsUInt8 *ubuf)
+{
     // Zero length
     // Seems to be required?
     nat_iowrite32(dataCtrl, DataTxCtrl_ena|DataTxCtrl_mode);
@@ -118,3 +170,200 @@ mrmDataBufTx::dataSend(epicsUInt32 len,
     // Measurements showed that we loop up to 17 times
     while(!(nat_ioread32(dataCtrl)&DataTxCtrl_done)) {};
 }
+
+bool
+mrmDataBufTx::dataSendAsync(epicsUInt32 len, const epicsUInt8 *buf,
+                            dataBufComplete fn, void* arg, unsigned coalesce)
+{
+    if (len > DataTxCtrl_len_max)
+        throw std::out_of_range("Tx buffer is too long");
+    if (coalesce!=0u && coalesce!=1u && coalesce!=2u && coalesce!=4u)
+        throw std::invalid_argument("Protocol ID width must be 1, 2, or 4");
+
+    len &= DataTxCtrl_len_mask;
+
+    // completion of a superseded buffer, called after unlock
+    dataBufComplete oldfn = 0;
+    void *oldarg = 0;
+    {
+        SCOPED_LOCK(txGuard);
+
+        if(stop)
+            throw std::logic_error("Tx queue stopped");
+
+        slot *S = 0;
+
+        // replace a queued buffer with the same Protocol ID, if requested by both
+        if(coalesce && len>=coalesce) {
+            for(size_t i=0; i<pending.size(); i++) {
+                slot *P = pending[i];
+                if(P->coalesce==coalesce && memcmp(&P->data[0], buf, coalesce)==0) {
+                    S = P;
+                    ncoalesced++;
+                    if(P->fn!=fn || P->fnarg!=arg) {
+                        oldfn = P->fn;
+                        oldarg = P->fnarg;
+                    }
+                    break;
+                }
+            }
+        }
+
+        if(!S) {
+            if(freeslots.empty()) {
+                ndropped++;
+                return false;
+            }
+            S = freeslots.back();
+            freeslots.pop_back();
+            pending.push_back(S);
+            if(pending.size()>nmax)
+                nmax = pending.size();
+            // a replaced entry keeps its place, and queue time
+            S->tqueue = 0u;
+            mrfLocalMonotonic(&S->tqueue);
+        }
+
+        S->len = len;
+        S->fn = fn;
+        S->fnarg = arg;
+        S->coalesce = len>=coalesce ? coalesce : 0u;
+        memcpy(&S->data[0], buf, len);
+
+        if(!running) {
+            running = true;
+            worker.start();
+        }
+    }
+
+    if(oldfn)
+        (*oldfn)(oldarg, 1, 0u, NULL);
+
+    wakeup.signal();
+    return true;
+}
+
+void
+mrmDataBufTx::run()
+{
+    sched.attach();
+
+    while(true) {
+        slot *S = 0;
+        {
+            SCOPED_LOCK(txGuard);
+            if(!pending.empty()) {
+                S = pending.front();
+                pending.pop_front();
+            } else if(stop) {
+                break;
+            }
+        }
+
+        if(!S) {
+            wakeup.wait();
+            continue;
+        }
+
+        epicsStatus ok = 0;
+        try {
+            SCOPED_LOCK(dataGuard);
+            sendNow(S->len, &S->data[0]);
+        } catch(std::exception& e) {
+            errlogPrintf("%s: Tx error: %s\n", name().c_str(), e.what());
+            ok = 2;
+        }
+        epicsUInt64 tsent = 0u;
+        const double lat = S->tqueue && mrfLocalMonotonic(&tsent) ? (tsent-S->tqueue)*1e-3 : 0.0; // us
+
+        if(S->fn)
+            (*S->fn)(S->fnarg, ok, ok ? 0u : S->len, ok ? NULL : &S->data[0]);
+
+        {
+            SCOPED_LOCK(txGuard);
+            if(ok) {
+                ndropped++;
+            } else {
+                nsent++;
+                latSum += lat;
+                if(lat>latMax)
+                    latMax = lat;
+            }
+            freeslots.push_back(S);
+        }
+
+        scanIoRequest(sentScan);
+    }
+
+    sched.detach();
+}
+
+epicsUInt32
+mrmDataBufTx::txQueueDepth() const
+{
+    SCOPED_LOCK(txGuard);
+    return pending.size();
+}
+
+epicsUInt32
+mrmDataBufTx::txQueueDepthMax() const
+{
+    SCOPED_LOCK(txGuard);
+    return nmax;
+}
+
+epicsUInt32
+mrmDataBufTx::txSent() const
+{
+    SCOPED_LOCK(txGuard);
+    return nsent;
+}
+
+epicsUInt32
+mrmDataBufTx::txCoalesced() const
+{
+    SCOPED_LOCK(txGuard);
+    return ncoalesced;
+}
+
+epicsUInt32
+mrmDataBufTx::txDropped() const
+{
+    SCOPED_LOCK(txGuard);
+    return ndropped;
+}
+
+double
+mrmDataBufTx::txLatencyMean() const
+{
+    SCOPED_LOCK(txGuard);
+    return nsent ? latSum/nsent : 0.0;
+}
+
+double
+mrmDataBufTx::txLatencyMax() const
+{
+    SCOPED_LOCK(txGuard);
+    return latMax;
+}
+
+void
+mrmDataBufTx::txStatsReset()
+{
+    SCOPED_LOCK(txGuard);
+    nmax = pending.size();
+    nsent = ncoalesced = ndropped = 0u;
+    latSum = latMax = 0.0;
+}
+
+OBJECT_BEGIN2(mrmDataBufTx, dataBufTx)
+  OBJECT_PROP1("Tx Queue Depth", &mrmDataBufTx::txQueueDepth);
+  OBJECT_PROP1("Tx Queue Depth Max", &mrmDataBufTx::txQueueDepthMax);
+  OBJECT_PROP1("Tx Sent", &mrmDataBufTx::txSent);
+  OBJECT_PROP1("Tx Sent", &mrmDataBufTx::txSentScan);
+  OBJECT_PROP1("Tx Coalesced", &mrmDataBufTx::txCoalesced);
+  OBJECT_PROP1("Tx Dropped", &mrmDataBufTx::txDropped);
+  OBJECT_PROP1("Tx Latency Mean", &mrmDataBufTx::txLatencyMean);
+  OBJECT_PROP1("Tx Latency Max", &mrmDataBufTx::txLatencyMax);
+  OBJECT_PROP1("Tx Stats Reset", &mrmDataBufTx::txStatsReset);
+OBJECT_END(mrmDataBufTx)
@@ -8,21 +8,36 @@
 #ifndef MRMDATABUFTX_H_INC
 #define MRMDATABUFTX_H_INC
 
+#include <vector>
+#include <deque>
+
 #include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <dbScan.h>
 
 #include "mrf/databuf.h"
+#include "mrf/threadsched.h"
 
 /**
  * With the MRM both the EVG and the EVR have
  * the exact same Tx control register
+ *
+ * dataSendAsync() copies into one of a fixed number of staging buffers,
+ * which a worker thread sends in order.  So one buffer is staged while
+ * another is sent.  The worker is started on first use,
+ * and scheduled through "<name>:Sched".
  */
-class epicsShareClass mrmDataBufTx : public dataBufTx
+class epicsShareClass mrmDataBufTx : public mrf::ObjectInst<mrmDataBufTx, dataBufTx>,
+                                     protected epicsThreadRunable
 {
+    typedef mrf::ObjectInst<mrmDataBufTx, dataBufTx> base_t;
 public:
 
     mrmDataBufTx(const std::string& n,
                  volatile epicsUInt8* bufcontrol,
-                 volatile epicsUInt8* buffer);
+                 volatile epicsUInt8* buffer,
+                 unsigned qdepth=8);
     virtual ~mrmDataBufTx();
 
     /* locking done internally */
@@ -38,11 +53,67 @@ public:
 
     virtual void dataSend(epicsUInt32 len, const epicsUInt8 *buf) OVERRIDE FINAL;
 
+    virtual bool dataSendAsync(epicsUInt32 len, const epicsUInt8 *buf,
+                               dataBufComplete fptr=0, void* arg=0,
+                               unsigned coalesce=0u) OVERRIDE FINAL;
+
+    /** @name Async. queue statistics
+     */
+    //@{
+    //! Currently queued
+    epicsUInt32 txQueueDepth() const;
+    //! Most queued at once since reset
+    epicsUInt32 txQueueDepthMax() const;
+    //! Sent since reset.  Also scanned after each is sent
+    epicsUInt32 txSent() const;
+    IOSCANPVT txSentScan() const { return sentScan; }
+    //! Replaced by a later buffer with the same Protocol ID (when coalescing) since reset
+    epicsUInt32 txCoalesced() const;
+    //! Rejected as the queue was full, or failed, since reset
+    epicsUInt32 txDropped() const;
+    //! Time from dataSendAsync() until sent (us) since reset
+    double txLatencyMean() const;
+    double txLatencyMax() const;
+    void txStatsReset();
+    //@}
+
 private:
     volatile epicsUInt8 * const dataCtrl;
     volatile epicsUInt8 * const dataBuf;
 
+    // serializes hardware access
     epicsMutex dataGuard;
+
+    // write to hardware and wait for completion.  caller holds dataGuard
+    void sendNow(epicsUInt32 len, const epicsUInt8 *buf);
+
+    struct slot {
+        epicsUInt32 len;
+        dataBufComplete fn;
+        void *fnarg;
+        //! Protocol ID width for coalescing, or 0
+        unsigned coalesce;
+        //! mrfLocalMonotonic() when queued (ns), or 0
+        epicsUInt64 tqueue;
+        std::vector<epicsUInt8> data; // lenMax() bytes
+    };
+    // all slots, owned
+    std::vector<slot*> slots;
+
+    // guards below
+    mutable epicsMutex txGuard;
+    std::deque<slot*> pending;
+    std::vector<slot*> freeslots;
+    bool running, stop;
+    epicsUInt32 nmax, nsent, ncoalesced, ndropped;
+    double latSum, latMax;
+
+    IOSCANPVT sentScan;
+    epicsEvent wakeup;
+    mrf::ThreadSched sched;
+    epicsThread worker;
+
+    virtual void run();
 };
 
 #endif // MRMDATABUFTX_H_INC
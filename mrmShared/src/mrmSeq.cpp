@@ -10,14 +10,19 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include <epicsMath.h>
 #include <epicsMutex.h>
 #include <errlog.h>
 
+#include <mrfCommon.h>
 #include <mrfCommonIO.h>
 
 #include "mrmSeq.h"
+#include "seqcompile.h"
 
 #include <epicsExport.h>
 
@@ -43,6 +48,12 @@
 
 #define  EVG_SEQ_RAM_SRC_MASK 0x000000ff
 
+/* Entries in sequence RAM.  Each is two words, time then code */
+#define  EVG_SEQ_RAM_ENTRIES  2048
+
+/* Depth of the event FIFO of a downstream EVR */
+#define  EVR_FIFO_ENTRIES  511
+
 #if defined(__rtems__)
 #  define DEBUG(LVL, ARGS) do{if(SeqManagerDebug>=(LVL)) {printk ARGS ;}}while(0)
 #elif defined(vxWorks)
@@ -75,6 +86,15 @@ struct SeqHW
 
     epicsUInt32 ctrlreg_user, //!< user requested (based on commited sequence)
                 ctrlreg_hw;   //!< current in HW.  either same as _user or trigger disabled
+    //! upload request queued for SeqManager::run()
+    bool syncQueued;
+
+    // guarded by the mutex of loaded SoftSequence
+
+    //! last values written to RAM.  2 words per entry
+    std::vector<epicsUInt32> shadow;
+    //! false until the whole RAM has been written once
+    bool shadowValid;
 
     SeqHW(SeqManager * o,
           unsigned i,
@@ -88,6 +108,9 @@ struct SeqHW
         ,running(false)
         ,ctrlreg_user(0u)
         ,ctrlreg_hw(0u)
+        ,syncQueued(false)
+        ,shadow(2u*EVG_SEQ_RAM_ENTRIES, 0u)
+        ,shadowValid(false)
     {
         switch(owner->type) {
         case SeqManager::TypeEVG:
@@ -188,8 +211,8 @@ public:
     void setTimestamp(const double *arr, epicsUInt32 count)
     {
         const double tmult = getTimeScale();
-        times_t times(count);
-        // check for monotonic
+        epicsUInt64 prev = 0u;
+        // check for monotonic.  Nothing is stored until all are valid.
         // TODO: not handling overflow (HW supports controlled rollover w/ special 0xffffffff times)
         for(epicsUInt32 i=0; i<count; i++)
         {
@@ -200,23 +223,27 @@ public:
                 throw std::runtime_error(msg);
             }
 
-            times[i] = (arr[i]*tmult)+0.5;
+            epicsUInt64 time = (arr[i]*tmult)+0.5;
 
-            if(i>0 && times[i]<=times[i-1]) {
+            if(i>0 && time<=prev) {
                 std::string msg("Non-monotonic timestamp array");
                 last_err = msg;
                 scanIoRequest(onErr);
                 throw std::runtime_error(msg);
-            } else if(times[i]==0xffffffff) {
+            } else if(time==0xffffffff) {
                 std::string msg("Time overflow, rollover not supported");
                 last_err = msg;
                 scanIoRequest(onErr);
                 throw std::runtime_error(msg);
             }
+            prev = time;
         }
         {
             SCOPED_LOCK(mutex);
-            scratch.times.swap(times);
+            // within preallocated capacity unless count>EVG_SEQ_RAM_ENTRIES
+            scratch.times.resize(count);
+            for(epicsUInt32 i=0; i<count; i++)
+                scratch.times[i] = (arr[i]*tmult)+0.5;
             is_committed = false;
         }
         DEBUG(4, ("Set times\n"));
@@ -236,13 +263,9 @@ public:
 
     void setEventCode(const epicsUInt8* arr, epicsUInt32 count)
     {
-        codes_t codes(count);
-        std::copy(arr,
-                  arr+count,
-                  codes.begin());
         {
             SCOPED_LOCK(mutex);
-            scratch.codes.swap(codes);
+            scratch.codes.assign(arr, arr+count);
             is_committed = false;
         }
         DEBUG(4, ("Set events\n"));
@@ -261,19 +284,15 @@ public:
 
     void setMask(const epicsUInt8 *arr, epicsUInt32 count)
     {
-        masks_t masks(count);
         if (*arr>15){
             std::string msg("4 bits code. Authorized range is [0-15]");
             last_err = msg;
             scanIoRequest(onErr);
             throw std::runtime_error(msg);
         }
-        std::copy(arr,
-                  arr + count,
-                  masks.begin());
         {
             SCOPED_LOCK(mutex);
-            scratch.masks.swap(masks);
+            scratch.masks.assign(arr, arr+count);
             is_committed = false;
         }
         DEBUG(4, ("Set masks\n"));
@@ -298,13 +317,9 @@ public:
             scanIoRequest(onErr);
             throw std::runtime_error(msg);
         }
-        enables_t enables(count);
-        std::copy(arr,
-                  arr + count,
-                  enables.begin());
         {
             SCOPED_LOCK(mutex);
-            scratch.enables.swap(enables);
+            scratch.enables.assign(arr, arr+count);
             is_committed = false;
         }
         DEBUG(4, ("Set enables\n"));
@@ -321,6 +336,46 @@ public:
         return ret;
     }
 
+    //! Compile a textual description into times, codes, masks and enables.  See SeqCompiler
+    void setProgram(const epicsInt8 *arr, epicsUInt32 count)
+    {
+        // waveform of CHAR.  Stop at the first nil, if any
+        const char *text = (const char*)arr;
+        std::string prog(text, std::find(text, text+count, '\0'));
+        {
+            SCOPED_LOCK(mutex);
+            try {
+                // no RAM limit when streaming
+                compiler.compile(prog, owner->getClkFreq(),
+                                 scratch.period ? 0u : EVG_SEQ_RAM_ENTRIES,
+                                 compiled);
+            } catch(std::runtime_error& e) {
+                std::string msg(e.what());
+                last_err = msg;
+                scanIoRequest(onErr);
+                throw std::runtime_error(msg);
+            }
+            program.swap(prog);
+            scratch.times.assign(compiled.times.begin(), compiled.times.end());
+            scratch.codes.assign(compiled.codes.begin(), compiled.codes.end());
+            scratch.masks.assign(compiled.masks.begin(), compiled.masks.end());
+            scratch.enables.assign(compiled.enables.begin(), compiled.enables.end());
+            is_committed = false;
+        }
+        DEBUG(4, ("Set program, %u entries\n", (unsigned)compiled.size()));
+        scanIoRequest(changed);
+    }
+
+    epicsUInt32 getProgram(epicsInt8 *arr, epicsUInt32 count) const
+    {
+        SCOPED_LOCK(mutex);
+        epicsUInt32 ret = std::min(size_t(count), program.size());
+        std::copy(program.begin(),
+                  program.begin() + ret,
+                  arr);
+        return ret;
+    }
+
     void setTrigSrc(epicsUInt32 src)
     {
         DEBUG(4, ("Setting trig src %x\n", (unsigned)src));
@@ -367,6 +422,41 @@ public:
         return committed.mode;
     }
 
+    void setStreamPeriod(double val)
+    {
+        const double tmult = getTimeScale();
+        // range check before conversion to integer
+        const double ticks = (val*tmult)+0.5;
+        if(!finite(val) || val<0.0 || !(ticks<double(0xffffffff))) {
+            std::string msg("Stream period must be >=0 and less than 2**32 ticks");
+            last_err = msg;
+            scanIoRequest(onErr);
+            throw std::runtime_error(msg);
+        }
+        const epicsUInt64 period = epicsUInt64(ticks);
+        {
+            SCOPED_LOCK(mutex);
+            scratch.period = period;
+            is_committed = false;
+        }
+        DEBUG(4, ("Set stream period %u\n", (unsigned)period));
+        scanIoRequest(changed);
+    }
+
+    double getStreamPeriod() const
+    {
+        SCOPED_LOCK(mutex);
+        return committed.period/getTimeScale();
+    }
+
+    epicsUInt32 streamChunks() const
+    {
+        SCOPED_LOCK(mutex);
+        if(!committed.period || committed.times.empty())
+            return 0u;
+        return committed.times.back()/committed.period + 1u;
+    }
+
     // dset actions
     // control/status
 
@@ -392,17 +482,77 @@ public:
     IOSCANPVT counterStartScan() const { return onStart; }
     epicsUInt32 counterEnd() const { interruptLock L; return numEnd; }
     IOSCANPVT counterEndScan() const { return onEnd; }
+    epicsUInt32 counterSwap() const { interruptLock L; return numSwap; }
+    epicsUInt32 counterUnderrun() const { interruptLock L; return numUnderrun; }
+
+    bool getPingPong() const { SCOPED_LOCK(mutex); return pingPong; }
+    void setPingPong(bool v) { SCOPED_LOCK(mutex); pingPong = v; }
+
+    // analysis of the committed sequence
+
+    //! Least time between two events, in TIMEUNITS.  0 if less than two events
+    double getMinSpacing() const
+    {
+        SCOPED_LOCK(mutex);
+        return analysis.minSpacing/getTimeScale();
+    }
+
+    //! Rate of each event code (events/sec), over one run of the sequence
+    epicsUInt32 getCodeRates(double *arr, epicsUInt32 count) const
+    {
+        SCOPED_LOCK(mutex);
+        const double runtime = std::max(analysis.duration, epicsUInt64(1u))/owner->getClkFreq();
+        epicsUInt32 ret = std::min(count, 256u);
+        for(epicsUInt32 i=0; i<ret; i++)
+            arr[i] = analysis.counts[i]/runtime;
+        return ret;
+    }
+
+    epicsUInt32 getFIFOPeak() const { SCOPED_LOCK(mutex); return analysis.fifoPeak; }
+    epicsUInt32 getCollisions() const { SCOPED_LOCK(mutex); return analysis.collisions; }
+
+    double getFIFODrain() const { SCOPED_LOCK(mutex); return fifoDrain; }
+    void setFIFODrain(double v)
+    {
+        if(!finite(v) || v<=0.0) {
+            std::string msg("FIFO drain rate must be positive");
+            last_err = msg;
+            scanIoRequest(onErr);
+            throw std::runtime_error(msg);
+        }
+        SCOPED_LOCK(mutex);
+        fifoDrain = v;
+    }
+
+    epicsUInt32 getFIFOLimit() const { SCOPED_LOCK(mutex); return fifoLimit; }
+    void setFIFOLimit(epicsUInt32 v) { SCOPED_LOCK(mutex); fifoLimit = v; }
 
     // internal
 
+    //! Load committed sequence into HW, if not running.  Call with mutex, without interruptLock.
     void sync();
+    //! Load committed sequence, or next stream chunk, into standby HW, then swap.
+    //! Call with mutex, without interruptLock.
+    void stage();
+    //! Begin streaming committed from the first chunk.  Call with interruptLock
+    void startStream();
+    //! Make standby the active HW.  Call with interruptLock.
+    void swapHW();
+    //! Prepare control register for sync().  Call with interruptLock.  false if running
+    bool syncCtrl(SeqHW *H);
+    //! Write RAM entries which differ from the shadow.  Call with mutex only.  Returns words written.
+    //! Writes committed entries [first, last) less offset, and a trailing 0x7f if needed.
+    size_t syncRAM(SeqHW *H, size_t first, size_t last, epicsUInt64 offset);
 
     SeqManager * const owner;
 
     //! guarded by our mutex and interruptLock
     //! only write when both held
     //! read when either held
+    //! In ping-pong mode hw and standby are also swapped by the ISR with only interruptLock.
     SeqHW *hw;
+    //! In ping-pong mode, the second (idle) HW.  Otherwise NULL.  Same guard as hw.
+    SeqHW *standby;
 
     mutable epicsMutex mutex;
 
@@ -418,10 +568,20 @@ public:
         enables_t enables;
         RunMode mode;
         epicsUInt32 src;
+        //! Stream chunk length in ticks.  0 when not streaming
+        epicsUInt64 period;
         Config()
             :mode(Single)
             ,src(0x03000000) // code for Disable
+            ,period(0u)
         {}
+        void reserve(size_t n)
+        {
+            times.reserve(n);
+            codes.reserve(n);
+            masks.reserve(n);
+            enables.reserve(n);
+        }
         void swap(Config& o)
         {
             std::swap(times, o.times);
@@ -430,9 +590,41 @@ public:
             std::swap(enables, o.enables);
             std::swap(mode, o.mode);
             std::swap(src, o.src);
+            std::swap(period, o.period);
         }
     } scratch,   // guarded by our mutex only
+      staging,   // guarded by our mutex only.  holds the previous committed
       committed; // guarded by interruptLock only
+    // All have capacity for EVG_SEQ_RAM_ENTRIES, so commit() does not allocate
+
+    //! Check chunks of a sequence to be streamed.  Call with mutex.  Throws if invalid
+    void checkStream(const Config& conf);
+
+    /* Load which a sequence places on the event link, and on the FIFO of a downstream EVR.
+     * Event codes 0 and 0x7f are not sent, and are not counted.
+     * Masks are ignored, so this is an upper bound.
+     */
+    struct Analysis {
+        //! ticks.  0 if less than two events
+        epicsUInt64 minSpacing;
+        //! ticks, to the 0x7f
+        epicsUInt64 duration;
+        //! # of each code in one run
+        epicsUInt32 counts[256];
+        //! Most events queued in an EVR FIFO drained at fifoDrain.  From empty, one run
+        epicsUInt32 fifoPeak;
+        //! # of events with a code also sent by another source.  See SeqManager::busEventCodes()
+        epicsUInt32 collisions;
+    } analysis, // of committed.  guarded by our mutex
+      analysisNext; // of staging.  guarded by our mutex
+
+    //! Fill analysisNext.  O(n).  Call with mutex.  Throws if over fifoLimit
+    void analyze(const Config& conf);
+
+    //! Assumed EVR FIFO drain rate (events/sec)
+    double fifoDrain;
+    //! Reject a commit if analysis fifoPeak exceeds.  0 to never reject
+    epicsUInt32 fifoLimit;
 
     //! Whether user has requested enable
     bool is_enabled;
@@ -442,14 +634,42 @@ public:
     //! Guarded by interruptLock only
     bool is_insync;
 
+    //! standby holds the committed sequence, swap at next end of sequence.
+    //! Guarded by interruptLock only
+    bool standbyReady;
+
+    //! Whether user has requested ping-pong.  Applied on load()
+    bool pingPong;
+
+    /* Streaming.  When committed.period!=0 the committed sequence is split
+     * into chunks of one period, each played by one trigger.
+     * Chunks are staged into standby, swapped at end of sequence.
+     */
+    //! next chunk to stage (index of first entry, and chunk number).  Guarded by our mutex
+    size_t streamNext;
+    epicsUInt64 streamChunk;
+    //! Guarded by interruptLock only
+    //! staging chunk zero.  So don't wait for end of the active chunk.
+    bool streamRestart;
+    //! the chunk in standby/active is the last
+    bool standbyLast, activeLast;
+    //! active chunk ended before the next was staged
+    bool streamStalled;
+
     //! Guarded by interruptLock only
-    epicsUInt32 numStart, numEnd;
+    epicsUInt32 numStart, numEnd, numSwap, numUnderrun;
 
     epicsUInt32 timeScale;
 
     IOSCANPVT changed, onStart, onEnd, onErr;
 
     std::string last_err;
+
+    //! guarded by our mutex
+    SeqCompiler compiler;
+    SeqArrays compiled;
+    //! as last set successfully
+    std::string program;
 };
 
 OBJECT_BEGIN(SoftSequence)
@@ -479,10 +699,31 @@ OBJECT_BEGIN(SoftSequence)
   OBJECT_PROP1("MASK", &SoftSequence::stateChange);
   OBJECT_PROP2("ENA", &SoftSequence::getEna, &SoftSequence::setEna);
   OBJECT_PROP1("ENA", &SoftSequence::stateChange);
+  OBJECT_PROP2("PROGRAM", &SoftSequence::getProgram, &SoftSequence::setProgram);
+  OBJECT_PROP1("PROGRAM", &SoftSequence::stateChange);
   OBJECT_PROP1("NUM_RUNS", &SoftSequence::counterEnd);
   OBJECT_PROP1("NUM_RUNS", &SoftSequence::counterEndScan);
   OBJECT_PROP1("NUM_STARTS", &SoftSequence::counterStart);
   OBJECT_PROP1("NUM_STARTS", &SoftSequence::counterStartScan);
+  OBJECT_PROP1("NUM_SWAPS", &SoftSequence::counterSwap);
+  OBJECT_PROP1("NUM_SWAPS", &SoftSequence::counterEndScan);
+  OBJECT_PROP2("PINGPONG", &SoftSequence::getPingPong, &SoftSequence::setPingPong);
+  OBJECT_PROP2("STREAM_PERIOD", &SoftSequence::getStreamPeriod, &SoftSequence::setStreamPeriod);
+  OBJECT_PROP1("STREAM_PERIOD", &SoftSequence::stateChange);
+  OBJECT_PROP1("STREAM_CHUNKS", &SoftSequence::streamChunks);
+  OBJECT_PROP1("STREAM_CHUNKS", &SoftSequence::stateChange);
+  OBJECT_PROP1("STREAM_UNDERRUNS", &SoftSequence::counterUnderrun);
+  OBJECT_PROP1("STREAM_UNDERRUNS", &SoftSequence::counterEndScan);
+  OBJECT_PROP1("MIN_SPACING", &SoftSequence::getMinSpacing);
+  OBJECT_PROP1("MIN_SPACING", &SoftSequence::stateChange);
+  OBJECT_PROP1("CODE_RATES", &SoftSequence::getCodeRates);
+  OBJECT_PROP1("CODE_RATES", &SoftSequence::stateChange);
+  OBJECT_PROP1("FIFO_PEAK", &SoftSequence::getFIFOPeak);
+  OBJECT_PROP1("FIFO_PEAK", &SoftSequence::stateChange);
+  OBJECT_PROP1("COLLISIONS", &SoftSequence::getCollisions);
+  OBJECT_PROP1("COLLISIONS", &SoftSequence::stateChange);
+  OBJECT_PROP2("FIFO_DRAIN", &SoftSequence::getFIFODrain, &SoftSequence::setFIFODrain);
+  OBJECT_PROP2("FIFO_LIMIT", &SoftSequence::getFIFOLimit, &SoftSequence::setFIFOLimit);
   OBJECT_PROP2("TIMEUNITS", &SoftSequence::getTimestampResolution, &SoftSequence::setTimestampResolution);
   OBJECT_PROP2("TRIG_SRC", &SoftSequence::getTrigSrcCt, &SoftSequence::setTrigSrc);
   OBJECT_PROP1("TRIG_SRC", &SoftSequence::stateChange);
@@ -494,13 +735,31 @@ SoftSequence::SoftSequence(SeqManager *o, const std::string& name)
     :base_t(name)
     ,owner(o)
     ,hw(0)
+    ,standby(0)
+    ,fifoDrain(10000.0) // EVR default FIFO rate budget
+    ,fifoLimit(0u)
     ,is_enabled(false)
     ,is_committed(false)
     ,is_insync(false)
+    ,standbyReady(false)
+    ,pingPong(false)
+    ,streamNext(0u)
+    ,streamChunk(0u)
+    ,streamRestart(false)
+    ,standbyLast(false)
+    ,activeLast(false)
+    ,streamStalled(false)
     ,numStart(0u)
     ,numEnd(0u)
+    ,numSwap(0u)
+    ,numUnderrun(0u)
     ,timeScale(0u) // raw/ticks
 {
+    memset(&analysis, 0, sizeof(analysis));
+    memset(&analysisNext, 0, sizeof(analysisNext));
+    scratch.reserve(EVG_SEQ_RAM_ENTRIES);
+    staging.reserve(EVG_SEQ_RAM_ENTRIES);
+    committed.reserve(EVG_SEQ_RAM_ENTRIES);
     scanIoInit(&changed);
     scanIoInit(&onStart);
     scanIoInit(&onEnd);
@@ -623,6 +882,8 @@ void SoftSequence::load()
     DEBUG(3, ("Loading %c\n", hw ? 'L' : 'U') );
     if(hw) {DEBUG(3, ("Skip\n")); return;}
 
+    bool running = false;
+
     // find unused SeqHW
     {
         interruptLock L;
@@ -638,15 +899,41 @@ void SoftSequence::load()
             }
         }
 
+        if(hw && pingPong) {
+            for(size_t i=0, N=owner->hw.size(); i<N; i++) {
+                SeqHW *temp = owner->hw[i];
+                if(temp && !temp->loaded) {
+                    temp->loaded = this;
+                    standby = temp;
+                    break;
+                }
+            }
+        }
+
         if(hw) {
             // paranoia: disable any external trigger mappings
             owner->mapTriggerSrc(hw->idx, 0x02000000);
 
-            if(!hw->disarm())
-                sync();
+            // if running, sync at end of sequence
+            running = hw->disarm();
+        }
+
+        if(standby) {
+            owner->mapTriggerSrc(standby->idx, 0x02000000);
+            standby->disarm();
+            standbyReady = false;
+
+            if(committed.period)
+                startStream();
+            else if(running)
+                owner->requestSync(standby->idx); // swap at end of sequence
         }
     }
 
+    // when streaming, or running in ping-pong mode, run() stages
+    if(hw && !running && !(standby && committed.period))
+        sync();
+
     if(!hw) {
         last_err = "All HW Seq. in use";
         scanIoRequest(onErr);
@@ -654,7 +941,12 @@ void SoftSequence::load()
     }
 
     // clear residual error (if any)
-    last_err = "";
+    if(pingPong && !standby)
+        last_err = "No idle HW Seq., ping-pong not used";
+    else if(committed.period && !standby)
+        last_err = "Streaming requires ping-pong";
+    else
+        last_err = "";
     scanIoRequest(onErr);
 
     scanIoRequest(changed);
@@ -678,7 +970,14 @@ void SoftSequence::unload()
         hw->loaded = NULL;
         hw = NULL;
 
+        if(standby) {
+            standby->disarm();
+            standby->loaded = NULL;
+            standby = NULL;
+        }
+
         is_insync = false;
+        standbyReady = false;
     }
 
     scanIoRequest(changed);
@@ -695,25 +994,52 @@ void SoftSequence::commit()
 
     // scratch.times already check for monotonic
 
-    Config conf(scratch); // vector copies
-
-    size_t buflen = std::min(conf.codes.size(),
-                             conf.times.size());
-    conf.codes.resize(buflen);
-    conf.times.resize(buflen);
-    conf.enables.resize(buflen);
-    conf.masks.resize(buflen);
+    const size_t buflen = std::min(scratch.codes.size(),
+                                   scratch.times.size());
 
     // ensure presence of trailing end of sequence marker event 0x7f
-    if(conf.codes.empty() || conf.codes.back()!=0x7f)
-    {
-        if(!conf.times.empty() && conf.times.back()==0xffffffff) {
-            std::string msg("Input array is missing 0x7f and maxing out times");
-            last_err = msg;
-            scanIoRequest(onErr);
-            throw std::runtime_error(msg);
-        }
+    const bool addEnd = buflen==0u || scratch.codes[buflen-1u]!=0x7f;
+
+    if(addEnd && buflen>0u && scratch.times[buflen-1u]==0xffffffff) {
+        std::string msg("Input array is missing 0x7f and maxing out times");
+        last_err = msg;
+        scanIoRequest(onErr);
+        throw std::runtime_error(msg);
+    }
 
+    if(!scratch.period && buflen+(addEnd?1u:0u)>EVG_SEQ_RAM_ENTRIES) {
+        std::string msg("Sequence too long");
+        last_err = msg;
+        scanIoRequest(onErr);
+        throw std::runtime_error(msg);
+    }
+
+    if(scratch.period && hw && !standby) {
+        std::string msg("Streaming requires ping-pong");
+        last_err = msg;
+        scanIoRequest(onErr);
+        throw std::runtime_error(msg);
+    }
+
+    // copy into preallocated staging.
+    // No allocation as buflen<=EVG_SEQ_RAM_ENTRIES, unless streaming
+    Config& conf = staging;
+
+    conf.times.assign(scratch.times.begin(), scratch.times.begin()+buflen);
+    conf.codes.assign(scratch.codes.begin(), scratch.codes.begin()+buflen);
+    // masks and enables may be shorter.  zero fill
+    conf.masks.assign(scratch.masks.begin(),
+                      scratch.masks.begin()+std::min(buflen, scratch.masks.size()));
+    conf.masks.resize(buflen, 0);
+    conf.enables.assign(scratch.enables.begin(),
+                        scratch.enables.begin()+std::min(buflen, scratch.enables.size()));
+    conf.enables.resize(buflen, 0);
+    conf.mode = scratch.mode;
+    conf.src = scratch.src;
+    conf.period = scratch.period;
+
+    if(addEnd)
+    {
         conf.codes.push_back(0x7f);
 
         if(conf.times.empty())
@@ -723,30 +1049,55 @@ void SoftSequence::commit()
 
         conf.masks.push_back(0);
         conf.enables.push_back(0);
-
     }
 
-    if(conf.times.size()>2048) {
-        std::string msg("Sequence too long");
-        last_err = msg;
-        scanIoRequest(onErr);
-        throw std::runtime_error(msg);
-    }
+    if(conf.period)
+        checkStream(conf);
+
+    analyze(conf);
 
     assert(!hw || hw->loaded==this);
 
+    bool running = false;
     {
         interruptLock L;
         committed.swap(conf);
         is_committed = true;
         is_insync = false;
 
-        if(hw && !hw->disarm())
-            sync();
+        if(standby) {
+            // Replaces any previously staged sequence.
+            // Active HW keeps running, and keeps its trigger until the standby is ready.
+            if(standbyReady && is_enabled)
+                hw->arm();
+            standbyReady = false;
+            if(committed.period)
+                startStream();
+            else
+                owner->requestSync(standby->idx);
+
+        } else if(hw) {
+            // if running, sync at end of sequence
+            running = hw->disarm();
+        }
     }
 
-    // clear residual error (if any)
-    last_err = "";
+    // in ping-pong mode, run() stages
+    if(hw && !standby && !running)
+        sync();
+
+    analysis = analysisNext;
+
+    // clear residual error (if any), or warn of a questionable, but accepted, sequence
+    if(analysis.collisions) {
+        last_err = SB()<<"Warning: "<<analysis.collisions
+                       <<" events with codes also sent by trigger events or timestamping";
+    } else if(analysis.fifoPeak > EVR_FIFO_ENTRIES) {
+        last_err = SB()<<"Warning: projected EVR FIFO peak "<<analysis.fifoPeak
+                       <<" events exceeds HW FIFO";
+    } else {
+        last_err = "";
+    }
     scanIoRequest(onErr);
 
     scanIoRequest(changed);
@@ -765,7 +1116,10 @@ void SoftSequence::enable()
     if(hw) {
         interruptLock I;
 
-        hw->arm();
+        if(standby && committed.period && activeLast)
+            startStream(); // replay from the first chunk
+        else
+            hw->arm();
     }
 
     // clear residual error (if any)
@@ -794,34 +1148,266 @@ void SoftSequence::disable()
     DEBUG(1, ("Disabled\n") );
 }
 
-// Called from ISR context
+/* RAM is written without interruptLock, so IRQs are not blocked for long.
+ * This is safe as the trigger source is disabled and the sequencer is not running.
+ * The mutex excludes softTrig() and changes to committed.
+ */
 void SoftSequence::sync()
 {
-    DEBUG(3, ("Syncing %c\n", is_insync ? 'Y' : 'N') );
-    if(is_insync)
-        {DEBUG(3, ("Skip\n")); return;}
-
     assert(hw);
+    {
+        interruptLock L;
+        DEBUG(3, ("Syncing %c\n", is_insync ? 'Y' : 'N') );
+        if(is_insync)
+            {DEBUG(3, ("Skip\n")); return;}
+        if(committed.period)
+            {DEBUG(1, ("Can't stream w/o ping-pong\n")); return;}
+
+        if(!syncCtrl(hw))
+            return;
+    }
+
+    size_t nwrite = syncRAM(hw, 0u, committed.codes.size(), 0u);
+    DEBUG(3, ("  Wrote %u words\n", (unsigned)nwrite));
 
-    if(nat_ioread32(hw->ctrlreg)&EVG_SEQ_RAM_RUNNING) {
+    {
+        interruptLock L;
+        epicsUInt32 ctrl = hw->ctrlreg_hw = hw->ctrlreg_user;
+        if(is_enabled)
+            ctrl |= EVG_SEQ_RAM_ARM;
+        else
+            ctrl |= EVG_SEQ_RAM_DISABLE; // paranoia
+
+        DEBUG(3, ("  SeqCtrl %x\n", ctrl));
+        nat_iowrite32(hw->ctrlreg, ctrl);
+
+        is_insync = true;
+    }
+    DEBUG(3, ("In Sync\n") );
+}
+
+/* Ping-pong mode.  The committed sequence is written to the standby HW while
+ * the active HW continues to run.  Then the active HW trigger is disabled.
+ * If it is not running, swap now.  Otherwise the ISR swaps at end of sequence,
+ * which only writes control registers.
+ *
+ * When streaming, each chunk is written to standby while the previous chunk
+ * is active.  The active chunk keeps its trigger, and the ISR swaps at its end.
+ * If the active chunk has already ended (underrun) swap now.
+ */
+void SoftSequence::stage()
+{
+    assert(standby);
+    const bool stream = committed.period!=0u;
+    bool restart;
+    {
+        interruptLock L;
+        DEBUG(3, ("Staging %c\n", is_insync ? 'Y' : 'N') );
+        if(standbyReady || (!stream && is_insync) || (stream && !streamRestart && activeLast))
+            {DEBUG(3, ("Skip\n")); return;}
+        restart = streamRestart;
+
+        if(!syncCtrl(standby))
+            return;
+    }
+
+    size_t first = 0u, last = committed.codes.size();
+    epicsUInt64 offset = 0u;
+    bool final = true;
+
+    if(stream) {
+        // entries of the next chunk
+        const epicsUInt64 end = (streamChunk+1u)*committed.period;
+        first = streamNext;
+        offset = streamChunk*committed.period;
+        for(last=first; last<committed.times.size() && committed.times[last]<end; last++) {}
+
+        final = last==committed.times.size();
+        if(final && committed.mode==Normal) {
+            // repeat from the first chunk
+            streamNext = 0u;
+            streamChunk = 0u;
+        } else {
+            streamNext = last;
+            streamChunk++;
+        }
+    }
+
+    size_t nwrite = syncRAM(standby, first, last, offset);
+    DEBUG(3, ("  Wrote %u words\n", (unsigned)nwrite));
+
+    {
+        interruptLock L;
+        // trigger stays disabled until swapHW()
+        standby->disarm();
+        standbyLast = stream && final && committed.mode==Single;
+
+        if(!stream || restart) {
+            if(hw->disarm()) {
+                standbyReady = true;
+            } else {
+                swapHW();
+            }
+        } else if(streamStalled) {
+            // late.  start on the next trigger
+            swapHW();
+        } else {
+            standbyReady = true;
+        }
+    }
+    DEBUG(3, ("Staged\n") );
+}
+
+void SoftSequence::swapHW()
+{
+    SeqHW *prev = hw;
+    hw = standby;
+    standby = prev;
+    standbyReady = false;
+
+    // a stream chunk which just ended is still armed
+    prev->disarm();
+    owner->mapTriggerSrc(prev->idx, 0x02000000);
+
+    epicsUInt32 ctrl = hw->ctrlreg_hw = hw->ctrlreg_user;
+    if(is_enabled)
+        ctrl |= EVG_SEQ_RAM_ARM;
+    else
+        ctrl |= EVG_SEQ_RAM_DISABLE; // paranoia
+
+    nat_iowrite32(hw->ctrlreg, ctrl);
+
+    is_insync = true;
+    numSwap++;
+
+    if(committed.period) {
+        activeLast = standbyLast;
+        standbyLast = false;
+        streamStalled = false;
+        streamRestart = false;
+        // stage the next chunk
+        if(!activeLast)
+            owner->requestSync(prev->idx);
+    }
+}
+
+void SoftSequence::startStream()
+{
+    assert(standby);
+    streamNext = 0u;
+    streamChunk = 0u;
+    streamRestart = true;
+    streamStalled = false;
+    standbyLast = activeLast = false;
+    standbyReady = false;
+    owner->requestSync(standby->idx);
+}
+
+void SoftSequence::checkStream(const Config& conf)
+{
+    const epicsUInt64 P = conf.period;
+    const char *err = 0;
+
+    for(size_t first=0u, N=conf.times.size(); first<N && !err; ) {
+        const epicsUInt64 end = (conf.times[first]/P+1u)*P;
+        size_t last = first;
+        while(last<N && conf.times[last]<end)
+            last++;
+
+        // the 0x7f must come before the trigger for the next chunk
+        const bool addEnd = conf.codes[last-1u]!=0x7f;
+        if(last-first+(addEnd?1u:0u)>EVG_SEQ_RAM_ENTRIES)
+            err = "Too many events in one stream period";
+        else if(addEnd && conf.times[last-1u]+1u>=end)
+            err = "Event too close to end of stream period";
+
+        first = last;
+    }
+
+    if(err) {
+        std::string msg(err);
+        last_err = msg;
+        scanIoRequest(onErr);
+        throw std::runtime_error(msg);
+    }
+}
+
+void SoftSequence::analyze(const Config& conf)
+{
+    Analysis& A = analysisNext;
+    memset(&A, 0, sizeof(A));
+
+    bool shared[256];
+    std::fill(shared, shared+256, false);
+    owner->busEventCodes(shared);
+
+    const double drainPerTick = fifoDrain/owner->getClkFreq();
+    double backlog = 0.0, peak = 0.0;
+    bool first = true;
+    epicsUInt64 prev = 0u;
+
+    for(size_t i=0, N=conf.codes.size(); i<N; i++) {
+        const epicsUInt8 code = conf.codes[i];
+        const epicsUInt64 time = conf.times[i];
+
+        if(code==0x7f) {
+            A.duration = time;
+            break;
+        } else if(code==0) {
+            continue;
+        }
+
+        A.counts[code]++;
+        if(shared[code])
+            A.collisions++;
+
+        if(!first) {
+            const epicsUInt64 spacing = time-prev;
+            if(!A.minSpacing || spacing<A.minSpacing)
+                A.minSpacing = spacing;
+            backlog = std::max(0.0, backlog - spacing*drainPerTick);
+        }
+        backlog += 1.0;
+        peak = std::max(peak, backlog);
+
+        first = false;
+        prev = time;
+    }
+
+    A.fifoPeak = epicsUInt32(std::min(peak+0.5, 4294967295.0));
+
+    if(fifoLimit && A.fifoPeak > fifoLimit) {
+        std::string msg(SB()<<"Projected EVR FIFO peak "<<A.fifoPeak
+                            <<" events exceeds limit "<<fifoLimit);
+        last_err = msg;
+        scanIoRequest(onErr);
+        throw std::runtime_error(msg);
+    }
+}
+
+bool SoftSequence::syncCtrl(SeqHW *H)
+{
+    if(nat_ioread32(H->ctrlreg)&EVG_SEQ_RAM_RUNNING) {
         // we may still be _ENABLED at this point, but the trigger source is set to
         // Disabled, so this makes no difference.
-        epicsInterruptContextMessage("SoftSequence::sync() while running\n");
-        return;
+        // Will sync at end of sequence.
+        DEBUG(1, ("SoftSequence::sync() while running\n"));
+        return false;
     }
 
     // At this point the sequencer is not running and effectively disabled.
     // From paranoia, reset it anyway
-    nat_iowrite32(hw->ctrlreg, hw->ctrlreg_hw | EVG_SEQ_RAM_RESET);
+    nat_iowrite32(H->ctrlreg, H->ctrlreg_hw | EVG_SEQ_RAM_RESET);
 
-    hw->ctrlreg_user &= ~(EVG_SEQ_RAM_REPEAT_MASK|EVG_SEQ_RAM_SRC_MASK);
+    H->ctrlreg_user &= ~(EVG_SEQ_RAM_REPEAT_MASK|EVG_SEQ_RAM_SRC_MASK);
 
-    switch(committed.mode) {
+    // stream chunks are each played once per trigger
+    switch(committed.period ? Single : committed.mode) {
     case Single:
-        hw->ctrlreg_user |= EVG_SEQ_RAM_SINGLE;
+        H->ctrlreg_user |= EVG_SEQ_RAM_SINGLE;
         break;
     case Normal:
-        hw->ctrlreg_user |= EVG_SEQ_RAM_NORMAL;
+        H->ctrlreg_user |= EVG_SEQ_RAM_NORMAL;
         break;
     }
 
@@ -836,11 +1422,11 @@ void SoftSequence::sync()
         src = 63;
         break;
     default:
-        return;
+        return false;
     }
 
     // paranoia: disable any external trigger mappings
-    owner->mapTriggerSrc(hw->idx, 0x02000000);
+    owner->mapTriggerSrc(H->idx, 0x02000000);
 
     // map trigger source codes
     // MSB governs the type of mapping
@@ -855,7 +1441,7 @@ void SoftSequence::sync()
         // ignore 0x00ffffff
         switch(owner->type) {
         case SeqManager::TypeEVG:
-            src = 17+hw->idx;
+            src = 17+H->idx;
             break;
         case SeqManager::TypeEVR:
             src = 61;
@@ -866,8 +1452,8 @@ void SoftSequence::sync()
         DEBUG(5, ("  EXT mapping %x\n", committed.src));
         if(owner->type==SeqManager::TypeEVG) {
             // pass through to sub-class
-            owner->mapTriggerSrc(hw->idx, committed.src);
-            src = 24+hw->idx;
+            owner->mapTriggerSrc(H->idx, committed.src);
+            src = 24+H->idx;
         }
         break;
     case 0x03000000: // disable trigger
@@ -880,48 +1466,77 @@ void SoftSequence::sync()
     }
     DEBUG(5, ("  Trig Src %x\n", src));
 
-    hw->ctrlreg_user |= src;
+    H->ctrlreg_user |= src;
 
+    return true;
+}
+
+namespace {
+// write one RAM entry, if different from shadow.  Returns words written
+size_t writeEntry(volatile epicsUInt32 *ram, epicsUInt32 *shadow, bool all,
+                  size_t n, epicsUInt32 time, epicsUInt32 codesMasks)
+{
+    size_t nwrite = 0u;
+    if(all || shadow[2*n]!=time) {
+        nat_iowrite32(&ram[2*n], time);
+        shadow[2*n] = time;
+        nwrite++;
+    }
+    if(all || shadow[2*n+1]!=codesMasks) {
+        nat_iowrite32(&ram[2*n+1], codesMasks);
+        shadow[2*n+1] = codesMasks;
+        nwrite++;
+    }
+    return nwrite;
+}
+} // namespace
+
+size_t SoftSequence::syncRAM(SeqHW *H, size_t first, size_t last, epicsUInt64 offset)
+{
     // write out the RAM
-    volatile epicsUInt32 *ram = static_cast<volatile epicsUInt32 *>(hw->rambase);
-    for(size_t i=0, N=committed.codes.size(); i<N; i++)
+    volatile epicsUInt32 *ram = static_cast<volatile epicsUInt32 *>(H->rambase);
+    epicsUInt32 *shadow = &H->shadow[0];
+    const bool all = !H->shadowValid;
+    size_t nwrite = 0u, n = 0u;
+    bool ended = false;
+    epicsUInt32 time = 0u;
+
+    for(size_t i=first; i<last && n<EVG_SEQ_RAM_ENTRIES; i++)
     {
         epicsUInt32 codesMasks;
 
         DEBUG(5, ("  Code %u\n", committed.codes[i]));
 
+        time = committed.times[i]-offset;
         codesMasks = committed.codes[i];
         codesMasks |= committed.enables[i] << EVG_SEQ_RAM_SWENABLE_shift;
         codesMasks |= committed.masks[i] << EVG_SEQ_RAM_SWMASK_shift;
 
         //
         DEBUG(5, ("  Done, write %u\n", codesMasks));
-        nat_iowrite32(ram++, committed.times[i]);
-        nat_iowrite32(ram++, codesMasks);
-        if (committed.codes[i] == 0x7f)
-            break;
+        nwrite += writeEntry(ram, shadow, all, n++, time, codesMasks);
 
+        if (committed.codes[i] == 0x7f) {
+            ended = true;
+            break;
+        }
     }
 
-    {
-        epicsUInt32 ctrl = hw->ctrlreg_hw = hw->ctrlreg_user;
-        if(is_enabled)
-            ctrl |= EVG_SEQ_RAM_ARM;
-        else
-            ctrl |= EVG_SEQ_RAM_DISABLE; // paranoia
-
-        DEBUG(3, ("  SeqCtrl %x\n", ctrl));
-        nat_iowrite32(hw->ctrlreg, ctrl);
-    }
+    // end of a stream chunk
+    if(!ended && n<EVG_SEQ_RAM_ENTRIES)
+        nwrite += writeEntry(ram, shadow, all, n, n ? time+1u : 0u, 0x7f);
 
-    is_insync = true;
-    DEBUG(3, ("In Sync\n") );
+    H->shadowValid = true;
+    return nwrite;
 }
 
-
 SeqManager::SeqManager(const std::string &name, Type t)
     :base_t(name)
     ,type(t)
+    ,syncQueue(8, sizeof(int))
+    ,syncWorker(*this, (name+":SYNC").c_str(),
+                epicsThreadGetStackSize(epicsThreadStackSmall),
+                epicsThreadPriorityHigh)
 {
     switch(type) {
     case TypeEVG:
@@ -930,9 +1545,59 @@ SeqManager::SeqManager(const std::string &name, Type t)
     default:
         throw std::invalid_argument("Bad SeqManager type");
     }
+    syncWorker.start();
+}
+
+SeqManager::~SeqManager()
+{
+    int stop = -1;
+    syncQueue.send(&stop, sizeof(stop));
+    syncWorker.exitWait();
 }
 
-SeqManager::~SeqManager() {}
+// Called from ISR context
+void SeqManager::requestSync(unsigned i)
+{
+    SeqHW* HW = hw[i];
+    if(HW->syncQueued)
+        return;
+
+    int idx = i;
+    if(syncQueue.trySend(&idx, sizeof(idx))==0)
+        HW->syncQueued = true;
+    else
+        epicsInterruptContextMessage("SeqManager sync queue full\n");
+}
+
+void SeqManager::run()
+{
+    while(true) {
+        int idx = -1;
+        if(syncQueue.receive(&idx, sizeof(idx))!=int(sizeof(idx)) || idx<0)
+            break;
+
+        SeqHW* HW = hw[idx];
+        SoftSequence *seq;
+        {
+            interruptLock L;
+            HW->syncQueued = false;
+            seq = HW->loaded;
+        }
+        if(!seq)
+            continue;
+
+        try {
+            SCOPED_LOCK2(seq->mutex, G);
+            // may have been unloaded, or already synced by commit()
+            if(seq->hw==HW)
+                seq->sync();
+            else if(seq->standby==HW)
+                seq->stage();
+        } catch(std::exception& e) {
+            errlogPrintf("%s: sync error: %s\n", name().c_str(), e.what());
+        }
+    }
+}
 
 mrf::Object*
 SeqManager::buildSW(const std::string& name, const std::string& klass, const mrf::Object::create_args_t& args)
@@ -963,7 +1628,7 @@ void SeqManager::doStartOfSequence(unsigned i)
 
     SoftSequence *seq = HW->loaded;
 
-    if(!seq) return;
+    if(!seq || seq->standby==HW) return;
 
     seq->numStart++;
 
@@ -980,18 +1645,32 @@ void SeqManager::doEndOfSequence(unsigned i)
 
     SoftSequence *seq = HW->loaded;
 
-    if(!seq) return;
+    if(!seq || seq->standby==HW) return;
 
-    if(seq->committed.mode==Single) {
+    // when streaming, only the last chunk ends the sequence
+    const bool stream = seq->committed.period!=0u;
+    const bool finished = !stream || seq->activeLast;
+
+    if(seq->committed.mode==Single && finished) {
         seq->is_enabled = false;
     }
 
     seq->numEnd++;
 
+    if(seq->standbyReady) {
+        seq->swapHW();
+    } else if(!finished && !seq->streamRestart) {
+        // next chunk not staged in time
+        seq->numUnderrun++;
+        seq->streamStalled = true;
+    }
+
     scanIoRequest(seq->onEnd);
 
-    if(!seq->is_insync)
-        seq->sync();
+    // RAM is written by run(), to the standby HW in ping-pong mode.
+    // Staging which is queued, or done, is not repeated.
+    if(!seq->is_insync && !seq->standbyReady)
+        requestSync(seq->standby ? seq->standby->idx : i);
 
     if(seq->committed.mode==Single)
         scanIoRequest(seq->changed);
@@ -11,6 +11,8 @@
 #include <string>
 
 #include <dbScan.h>
+#include <epicsThread.h>
+#include <epicsMessageQueue.h>
 #include <shareLib.h>
 
 #include <mrf/object.h>
@@ -23,7 +25,16 @@
 struct SeqHW;
 struct SoftSequence;
 
-class epicsShareClass SeqManager : public mrf::ObjectInst<SeqManager>
+/* Sequence RAM is written by a worker thread when a SoftSequence is changed
+ * while running.  The ISR only queues a request at end of sequence.
+ * Only entries which differ from a shadow copy of the RAM are written.
+ *
+ * In ping-pong mode a SoftSequence loads two SeqHW.  A commit is written to
+ * the idle one while the other continues to run, then swapped at end of sequence.
+ * This also streams sequences longer than one RAM, one chunk per trigger.
+ */
+class epicsShareClass SeqManager : public mrf::ObjectInst<SeqManager>,
+                                   protected epicsThreadRunable
 {
     typedef mrf::ObjectInst<SeqManager> base_t;
 public:
@@ -61,6 +72,12 @@ public:
 
     virtual epicsUInt32 testStartOfSeq() =0;
 
+    //! sub-class may implement.
+    //! Set used[code] for event codes also sent by other sources (eg. trigger events).
+    //! used[] has 256 elements, all false.
+    //! called with a SoftSeq mutex held.
+    virtual void busEventCodes(bool *used) const {}
+
 protected:
     void addHW(unsigned i,
                volatile void *ctrl,
@@ -69,6 +86,14 @@ private:
     typedef std::vector<SeqHW*> hw_t;
     hw_t hw;
     friend struct SoftSequence;
+
+    //! Call from ISR, or with interruptLock.  Queue RAM upload for SeqHW i
+    void requestSync(unsigned i);
+
+    // SeqHW index to sync, or -1 to stop
+    epicsMessageQueue syncQueue;
+    epicsThread syncWorker;
+    virtual void run();
 };
 
 epicsShareExtern int SeqManagerDebug;
@@ -23,6 +23,7 @@
 #include <generalTimeSup.h>
 
 #include "mrfCommon.h"
+#include "mrf/threadsched.h"
 #include "mrmtimesrc.h"
 
 typedef epicsGuard<epicsMutex> Guard;
@@ -31,7 +32,7 @@ typedef epicsGuardRelease<epicsMutex> UnGuard;
 struct TimeStampSource::Impl
 {
     TimeStampSource * const owner;
-    Impl(TimeStampSource *owner, double period)
+    Impl(TimeStampSource *owner, double period, const std::string& schedPrefix)
         :owner(owner)
         ,timeoutRun(*this)
 #ifdef HAVE_CNS
@@ -44,7 +45,12 @@ struct TimeStampSource::Impl
         ,lastError(-1.0)
         ,period(period*1.1) // our timeout period is 10% longer than the expected reset period
         ,next(0u)
-    {}
+    {
+        if(!schedPrefix.empty()) {
+            timeoutSched.reset(new mrf::ThreadSched(schedPrefix+":Sched:TSTimeout"));
+            softsrcSched.reset(new mrf::ThreadSched(schedPrefix+":Sched:SoftTS"));
+        }
+    }
     ~Impl()
     {
         {
@@ -67,6 +73,9 @@ struct TimeStampSource::Impl
      */
     void runTimeout()
     {
+        if(timeoutSched.get())
+            timeoutSched->attach();
+
         Guard G(mutex);
 
         while(!stop) {
@@ -81,11 +90,17 @@ struct TimeStampSource::Impl
                 okCnt = 0u;
             }
         }
+
+        if(timeoutSched.get())
+            timeoutSched->detach();
     }
 
 #ifdef HAVE_CNS
     void runSrc()
     {
+        if(softsrcSched.get())
+            softsrcSched->attach();
+
         Guard G(mutex);
         while(!stopsrc) {
             UnGuard U(G);
@@ -116,6 +131,9 @@ struct TimeStampSource::Impl
 
             owner->postSoftSecondsSrc();
         }
+
+        if(softsrcSched.get())
+            softsrcSched->detach();
     }
 #endif
 
@@ -131,6 +149,9 @@ struct TimeStampSource::Impl
     epicsEvent wakeupsrc;
 #endif
 
+    // NULL when not requested
+    mrf::auto_ptr<mrf::ThreadSched> timeoutSched, softsrcSched;
+
     bool stop;
     bool resync;
     unsigned okCnt;
@@ -140,8 +161,8 @@ struct TimeStampSource::Impl
     epicsUInt32 next;
 };
 
-TimeStampSource::TimeStampSource(double period)
-    :impl(new Impl(this, period))
+TimeStampSource::TimeStampSource(double period, const std::string& schedPrefix)
+    :impl(new Impl(this, period, schedPrefix))
 {
     resyncSecond();
 }
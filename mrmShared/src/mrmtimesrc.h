@@ -18,7 +18,11 @@ class epicsShareClass TimeStampSource
     struct Impl;
     Impl * const impl;
 public:
-    explicit TimeStampSource(double period);
+    /** @param period Expected period of tickSecond() calls
+     *  @param schedPrefix If not empty, create mrf::ThreadSched objects
+     *         "<schedPrefix>:Sched:TSTimeout" and "<schedPrefix>:Sched:SoftTS" for internal threads
+     */
+    explicit TimeStampSource(double period, const std::string& schedPrefix = std::string());
     virtual ~TimeStampSource();
 
     //! Call to re-initialize timestamp counter from system time
@@ -0,0 +1,112 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+/* Micro-benchmark of SoftSequence commit.
+ *
+ * Measures setting TIMES and CODES, then COMMIT, as a feedback loop would
+ * each shot.  Once with the sequence unloaded (copy and swap only),
+ * and once loaded (also RAM upload).
+ * Sequencer RAM is the static regs[] array, so the loaded case counts
+ * the upload loop, but not the time of posted writes to a real device.
+ */
+
+#include <vector>
+#include <stdexcept>
+
+#include <epicsTime.h>
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#include "mrmSeq.h"
+
+namespace {
+
+// 2 controls, and 2 RAMs of 2048 entries
+epicsUInt32 regs[2 + 2*2*2048];
+
+struct BenchSeqManager : public SeqManager
+{
+    BenchSeqManager() :SeqManager("bench:SEQMGR", TypeEVG)
+    {
+        addHW(0, &regs[0], &regs[2]);
+        addHW(1, &regs[1], &regs[2+2*2048]);
+    }
+    virtual ~BenchSeqManager() {}
+
+    virtual double getClkFreq() const OVERRIDE FINAL { return 125e6; }
+    virtual void mapTriggerSrc(unsigned, unsigned) OVERRIDE FINAL {}
+    virtual epicsUInt32 testStartOfSeq() OVERRIDE FINAL { return 0; }
+};
+
+struct Props {
+    mrf::auto_ptr<mrf::property<double[1]> > times;
+    mrf::auto_ptr<mrf::property<epicsUInt8[1]> > codes;
+    mrf::auto_ptr<mrf::property<void> > commit;
+};
+
+void bench(Props& P, size_t count, const char *what)
+{
+    std::vector<double> times(count);
+    std::vector<epicsUInt8> codes(count);
+    for(size_t i=0; i<count; i++) {
+        times[i] = double(10u*(i+1u));
+        codes[i] = 1u + i%120u;
+    }
+
+    // repeat to total about 10M entries
+    const size_t reps = 10000000u/count;
+
+    const epicsTime T0(epicsTime::getCurrent());
+    for(size_t r=0; r<reps; r++) {
+        // vary one entry so each commit differs
+        times[count-1u] = double(10u*count + (r&1u));
+        P.times->set(&times[0], count);
+        P.codes->set(&codes[0], count);
+        P.commit->exec();
+    }
+    const epicsTime T1(epicsTime::getCurrent());
+
+    testDiag("%-8s %4u entries  %8.3f us/commit  %.3f ns/entry", what,
+             unsigned(count), (T1-T0)*1e6/reps, (T1-T0)*1e9/(reps*count));
+
+    std::vector<double> rb(count+1u);
+    epicsUInt32 n = P.times->get(&rb[0], rb.size());
+    testOk(n==count+1u, "Committed %u (with 0x7f)", unsigned(n));
+}
+
+} // namespace
+
+MAIN(seqcommitBench)
+{
+    testPlan(8);
+    try {
+        BenchSeqManager mgr;
+
+        mrf::Object::create_args_t args;
+        args["PARENT"] = mgr.name();
+        mrf::Object *seq = mrf::Object::getCreateObject("bench:SEQ0", "SeqManager", args);
+
+        Props P;
+        P.times = seq->getProperty<double[1]>("TIMES");
+        P.codes = seq->getProperty<epicsUInt8[1]>("CODES");
+        P.commit = seq->getProperty<void>("COMMIT");
+        mrf::auto_ptr<mrf::property<void> > load(seq->getProperty<void>("LOAD"));
+        if(!P.times.get() || !P.codes.get() || !P.commit.get() || !load.get())
+            throw std::logic_error("Missing SoftSequence property");
+
+        const size_t sizes[] = {16u, 128u, 1024u, 2047u};
+
+        for(size_t i=0; i<4u; i++)
+            bench(P, sizes[i], "unloaded");
+
+        load->exec();
+
+        for(size_t i=0; i<4u; i++)
+            bench(P, sizes[i], "loaded");
+
+    } catch(std::exception& e) {
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}
@@ -0,0 +1,483 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#include <stdexcept>
+#include <algorithm>
+#include <sstream>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <epicsMath.h>
+#include <epicsGuard.h>
+
+#define epicsExportSharedSymbols
+#include "seqcompile.h"
+
+typedef epicsGuard<epicsMutex> Guard;
+
+namespace {
+
+// limit when the caller has none (streaming), against runaway repeats
+const size_t hardLimit = 1u<<22;
+
+struct Token {
+    std::string text;
+    unsigned line;
+};
+
+struct Stmt {
+    enum Kind {At, After, Repeat} kind;
+    unsigned line;
+    epicsUInt64 time; // offset, or repeat period
+    epicsUInt8 code, mask, ena;
+    epicsUInt32 count; // repeat
+    std::vector<Stmt> body;
+};
+
+struct Ent {
+    epicsUInt64 time;
+    epicsUInt8 code, mask, ena;
+    unsigned line;
+    bool operator<(const Ent& o) const { return time<o.time; }
+};
+
+void fail(unsigned line, const std::string& msg)
+{
+    std::ostringstream strm;
+    strm<<"line "<<line<<": "<<msg;
+    throw std::runtime_error(strm.str());
+}
+
+bool special(char c)
+{
+    return c=='{' || c=='}' || c=='=' || c==';' || c=='#';
+}
+
+void tokenize(const std::string& text, std::vector<Token>& toks)
+{
+    unsigned line = 1u;
+    for(size_t i=0, N=text.size(); i<N; ) {
+        char c = text[i];
+        if(c=='\n') {
+            line++;
+            i++;
+        } else if(isspace((unsigned char)c) || c==';') {
+            i++;
+        } else if(c=='#') {
+            while(i<N && text[i]!='\n')
+                i++;
+        } else {
+            Token T;
+            T.line = line;
+            if(special(c)) {
+                T.text = c;
+                i++;
+            } else {
+                size_t start = i;
+                while(i<N && !isspace((unsigned char)text[i]) && !special(text[i]))
+                    i++;
+                T.text = text.substr(start, i-start);
+            }
+            toks.push_back(T);
+        }
+    }
+}
+
+struct Parser {
+    const std::vector<Token>& toks;
+    size_t pos;
+    const double clockHz;
+    std::map<std::string, epicsUInt8> names;
+
+    bool haveEnd;
+    Stmt end; // kind At or After, at top level
+
+    Parser(const std::vector<Token>& toks, double clockHz)
+        :toks(toks), pos(0u), clockHz(clockHz), haveEnd(false)
+    {}
+
+    unsigned line() const {
+        if(pos<toks.size())
+            return toks[pos].line;
+        return toks.empty() ? 1u : toks.back().line;
+    }
+
+    bool more() const { return pos<toks.size(); }
+
+    bool peek(const char *s) const { return pos<toks.size() && toks[pos].text==s; }
+
+    const std::string& next(const char *what) {
+        if(pos>=toks.size())
+            fail(line(), std::string("expected ")+what+" before end of input");
+        return toks[pos++].text;
+    }
+
+    void expect(const char *s) {
+        const std::string& T = next(s);
+        if(T!=s)
+            fail(toks[pos-1].line, std::string("expected '")+s+"' not '"+T+"'");
+    }
+
+    epicsUInt32 integer(const char *what, epicsUInt32 max) {
+        const std::string& T = next(what);
+        char *end = 0;
+        unsigned long val = strtoul(T.c_str(), &end, 0);
+        if(T.empty() || *end || !isdigit((unsigned char)T[0]) || val>max) {
+            std::ostringstream strm;
+            strm<<"expected "<<what<<" in range [0, "<<max<<"] not '"<<T<<"'";
+            fail(toks[pos-1].line, strm.str());
+        }
+        return epicsUInt32(val);
+    }
+
+    epicsUInt64 time() {
+        const std::string& T = next("time");
+        char *end = 0;
+        double val = strtod(T.c_str(), &end);
+        double mult = 1.0;
+        if(end==T.c_str() || !finite(val) || val<0.0)
+            fail(toks[pos-1].line, "expected time >=0 not '"+T+"'");
+        if(*end=='\0') {
+            // ticks
+        } else if(strcmp(end, "s")==0) {
+            mult = clockHz;
+        } else if(strcmp(end, "ms")==0) {
+            mult = clockHz*1e-3;
+        } else if(strcmp(end, "us")==0) {
+            mult = clockHz*1e-6;
+        } else if(strcmp(end, "ns")==0) {
+            mult = clockHz*1e-9;
+        } else {
+            fail(toks[pos-1].line, "unknown time unit in '"+T+"'");
+        }
+        double ticks = val*mult+0.5;
+        if(ticks>=18446744073709551615.0)
+            fail(toks[pos-1].line, "time out of range '"+T+"'");
+        return epicsUInt64(ticks);
+    }
+
+    static bool keyword(const std::string& s) {
+        return s=="event" || s=="at" || s=="after" || s=="repeat"
+                || s=="every" || s=="end" || s=="mask" || s=="ena";
+    }
+
+    void event(Stmt& S) {
+        const std::string& T = next("event code or name");
+        if(!T.empty() && isdigit((unsigned char)T[0])) {
+            pos--;
+            S.code = integer("event code", 255u);
+        } else {
+            std::map<std::string, epicsUInt8>::const_iterator it(names.find(T));
+            if(it==names.end())
+                fail(toks[pos-1].line, "unknown event name '"+T+"'");
+            S.code = it->second;
+        }
+        if(S.code==0x7f)
+            fail(S.line, "use 'end' to place event 0x7f");
+
+        S.mask = S.ena = 0u;
+        while(true) {
+            if(peek("mask")) {
+                pos++;
+                S.mask = integer("mask", 15u);
+            } else if(peek("ena")) {
+                pos++;
+                S.ena = integer("ena", 15u);
+            } else {
+                break;
+            }
+        }
+    }
+
+    void block(std::vector<Stmt>& body, bool top) {
+        while(more()) {
+            if(peek("}")) {
+                if(top)
+                    fail(line(), "unexpected '}'");
+                return;
+            }
+            Stmt S;
+            S.line = line();
+            S.count = 0u;
+            const std::string kw = next("statement");
+
+            if(kw=="event") {
+                const std::string name = next("name");
+                if(keyword(name) || name.empty() || isdigit((unsigned char)name[0]))
+                    fail(S.line, "invalid event name '"+name+"'");
+                expect("=");
+                epicsUInt32 code = integer("event code", 255u);
+                if(code==0x7f)
+                    fail(S.line, "event 0x7f can't be named");
+                names[name] = epicsUInt8(code);
+                continue;
+
+            } else if(kw=="at" || kw=="after") {
+                S.kind = kw=="at" ? Stmt::At : Stmt::After;
+                S.time = time();
+                event(S);
+
+            } else if(kw=="repeat") {
+                S.kind = Stmt::Repeat;
+                S.count = integer("repeat count", 0xffffffff);
+                expect("every");
+                S.time = time();
+                expect("{");
+                block(S.body, false);
+                expect("}");
+                if(S.body.empty())
+                    fail(S.line, "empty repeat");
+
+            } else if(kw=="end") {
+                if(!top)
+                    fail(S.line, "'end' must be outside of repeat");
+                if(haveEnd)
+                    fail(S.line, "duplicate 'end'");
+                haveEnd = true;
+                end = S;
+                end.kind = Stmt::After;
+                end.time = 1u;
+                if(peek("at") || peek("after")) {
+                    end.kind = next("at")=="at" ? Stmt::At : Stmt::After;
+                    end.time = time();
+                }
+                continue;
+
+            } else {
+                fail(S.line, "unknown statement '"+kw+"'");
+            }
+            body.push_back(S);
+        }
+        if(!top)
+            fail(line(), "expected '}' before end of input");
+    }
+};
+
+struct Expander {
+    std::vector<Ent> ents;
+    // bounds both entries and repeat iterations
+    size_t limit;
+    size_t iterations;
+
+    Expander() :limit(0u), iterations(0u) {}
+
+    void emit(const Stmt& S, epicsUInt64 t) {
+        if(ents.size()>=limit)
+            fail(S.line, "Sequence too long");
+        Ent E;
+        E.time = t;
+        E.code = S.code;
+        E.mask = S.mask;
+        E.ena = S.ena;
+        E.line = S.line;
+        ents.push_back(E);
+    }
+
+    // cursor is the time of the previous event, updated
+    void expand(const std::vector<Stmt>& body, epicsUInt64 base, epicsUInt64& cursor) {
+        for(size_t i=0, N=body.size(); i<N; i++) {
+            const Stmt& S = body[i];
+            switch(S.kind) {
+            case Stmt::At:
+                cursor = base+S.time;
+                emit(S, cursor);
+                break;
+            case Stmt::After:
+                cursor += S.time;
+                emit(S, cursor);
+                break;
+            case Stmt::Repeat: {
+                const epicsUInt64 start = cursor;
+                for(epicsUInt32 n=0; n<S.count; n++) {
+                    if(++iterations>limit)
+                        fail(S.line, "Sequence too long");
+                    epicsUInt64 rbase = start + n*S.time;
+                    cursor = rbase;
+                    expand(S.body, rbase, cursor);
+                }
+            }
+                break;
+            }
+        }
+    }
+};
+
+} // namespace
+
+void SeqArrays::clear()
+{
+    times.clear();
+    codes.clear();
+    masks.clear();
+    enables.clear();
+}
+
+void SeqArrays::reserve(size_t n)
+{
+    times.reserve(n);
+    codes.reserve(n);
+    masks.reserve(n);
+    enables.reserve(n);
+}
+
+void SeqCompiler::compileOnce(const std::string& text, double clockHz, size_t maxEntries, SeqArrays& out)
+{
+    if(!finite(clockHz) || clockHz<=0.0)
+        throw std::runtime_error("Sequencer clock frequency not known");
+
+    std::vector<Token> toks;
+    tokenize(text, toks);
+
+    Parser P(toks, clockHz);
+    std::vector<Stmt> prog;
+    P.block(prog, true);
+
+    Expander X;
+    // reserve one entry for 0x7f
+    X.limit = maxEntries ? maxEntries-1u : hardLimit;
+
+    epicsUInt64 cursor = 0u;
+    X.expand(prog, 0u, cursor);
+
+    std::stable_sort(X.ents.begin(), X.ents.end());
+
+    for(size_t i=1, N=X.ents.size(); i<N; i++) {
+        if(X.ents[i-1].time==X.ents[i].time) {
+            std::ostringstream strm;
+            strm<<"events from lines "<<X.ents[i-1].line<<" and "<<X.ents[i].line
+               <<" at the same time "<<X.ents[i].time;
+            fail(X.ents[i].line, strm.str());
+        }
+    }
+
+    // terminator
+    epicsUInt64 last = X.ents.empty() ? 0u : X.ents.back().time;
+    epicsUInt64 tend = X.ents.empty() ? 0u : last+1u;
+    if(P.haveEnd) {
+        tend = P.end.kind==Stmt::At ? P.end.time : last+P.end.time;
+        if(!X.ents.empty() && tend<=last)
+            fail(P.end.line, "'end' before the last event");
+    }
+    if(maxEntries && tend>=0xffffffff)
+        fail(P.haveEnd ? P.end.line : X.ents.back().line, "time overflow, rollover not supported");
+
+    const size_t N = X.ents.size();
+    out.times.resize(N+1u);
+    out.codes.resize(N+1u);
+    out.masks.resize(N+1u);
+    out.enables.resize(N+1u);
+    for(size_t i=0; i<N; i++) {
+        out.times[i] = X.ents[i].time;
+        out.codes[i] = X.ents[i].code;
+        out.masks[i] = X.ents[i].mask;
+        out.enables[i] = X.ents[i].ena;
+    }
+    out.times[N] = tend;
+    out.codes[N] = 0x7f;
+    out.masks[N] = out.enables[N] = 0u;
+}
+
+epicsUInt64 SeqCompiler::hash(const std::string& text, double clockHz, size_t maxEntries)
+{
+    // FNV-1a
+    epicsUInt64 H = 14695981039346656037ull;
+    for(size_t i=0, N=text.size(); i<N; i++) {
+        H ^= epicsUInt8(text[i]);
+        H *= 1099511628211ull;
+    }
+    epicsUInt8 params[sizeof(double)+sizeof(epicsUInt64)];
+    epicsUInt64 max = maxEntries;
+    memcpy(params, &clockHz, sizeof(clockHz));
+    memcpy(params+sizeof(clockHz), &max, sizeof(max));
+    for(size_t i=0; i<sizeof(params); i++) {
+        H ^= params[i];
+        H *= 1099511628211ull;
+    }
+    return H;
+}
+
+SeqCompiler::SeqCompiler(size_t cacheSize)
+    :cacheSize(cacheSize)
+    ,useCount(0u)
+    ,nhits(0u)
+    ,nmisses(0u)
+{}
+
+SeqCompiler::~SeqCompiler()
+{
+    for(cache_t::iterator it(cache.begin()), end(cache.end()); it!=end; ++it)
+        delete it->second;
+}
+
+void SeqCompiler::compile(const std::string& text, double clockHz, size_t maxEntries, SeqArrays& out)
+{
+    const epicsUInt64 key = hash(text, clockHz, maxEntries);
+
+    Guard G(lock);
+
+    std::pair<cache_t::iterator, cache_t::iterator> range(cache.equal_range(key));
+    for(; range.first!=range.second; ++range.first) {
+        Entry *E = range.first->second;
+        if(E->clockHz==clockHz && E->maxEntries==maxEntries && E->text==text) {
+            E->lastUse = ++useCount;
+            nhits++;
+            // copy within existing capacity
+            out.times.assign(E->result.times.begin(), E->result.times.end());
+            out.codes.assign(E->result.codes.begin(), E->result.codes.end());
+            out.masks.assign(E->result.masks.begin(), E->result.masks.end());
+            out.enables.assign(E->result.enables.begin(), E->result.enables.end());
+            return;
+        }
+    }
+
+    nmisses++;
+
+    Entry *E = new Entry;
+    try {
+        compileOnce(text, clockHz, maxEntries, E->result);
+    } catch(...) {
+        delete E;
+        throw;
+    }
+    E->text = text;
+    E->clockHz = clockHz;
+    E->maxEntries = maxEntries;
+    E->lastUse = ++useCount;
+
+    out.times.assign(E->result.times.begin(), E->result.times.end());
+    out.codes.assign(E->result.codes.begin(), E->result.codes.end());
+    out.masks.assign(E->result.masks.begin(), E->result.masks.end());
+    out.enables.assign(E->result.enables.begin(), E->result.enables.end());
+
+    if(cacheSize==0u) {
+        delete E;
+        return;
+    }
+
+    // evict least recently used
+    while(cache.size()>=cacheSize) {
+        cache_t::iterator lru(cache.begin());
+        for(cache_t::iterator it(cache.begin()), end(cache.end()); it!=end; ++it) {
+            if(it->second->lastUse < lru->second->lastUse)
+                lru = it;
+        }
+        delete lru->second;
+        cache.erase(lru);
+    }
+    cache.insert(std::make_pair(key, E));
+}
+
+size_t SeqCompiler::cacheHits() const
+{
+    Guard G(lock);
+    return nhits;
+}
+
+size_t SeqCompiler::cacheMisses() const
+{
+    Guard G(lock);
+    return nmisses;
+}
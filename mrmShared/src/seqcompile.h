@@ -0,0 +1,100 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+#ifndef SEQCOMPILE_H
+#define SEQCOMPILE_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <epicsTypes.h>
+#include <epicsMutex.h>
+#include <shareLib.h>
+
+/** @brief A compiled sequence.  Struct of arrays, as written to sequence RAM.
+ *
+ * Sorted by time, ending with event 0x7f.
+ */
+struct epicsShareClass SeqArrays {
+    std::vector<epicsUInt64> times; //!< ticks
+    std::vector<epicsUInt8> codes;
+    std::vector<epicsUInt8> masks;
+    std::vector<epicsUInt8> enables;
+
+    size_t size() const { return codes.size(); }
+    void clear();
+    void reserve(size_t n);
+};
+
+/** @brief Compile a textual sequence description.
+ *
+ * One statement per line (or separated by ';').  '#' starts a comment.
+ @code
+   event INJ = 20           # name an event code
+   at 10us INJ              # at time from start of enclosing block
+   after 100 21 mask 1      # relative to the previous event.  Also "ena"
+   repeat 4 every 1ms {     # body N times, shifted by the period each time
+     after 0 22
+     repeat 2 every 50us {  # nested
+       after 10us 23
+     }
+   }
+   end after 1ms            # optional.  Place the 0x7f explicitly
+ @endcode
+ *
+ * Times are in ticks, or seconds with a unit suffix "s", "ms", "us" or "ns".
+ * A repeat starts at the time of the preceding event (or the start of the enclosing block).
+ * Statements may be written in any order.  The result is sorted by time.
+ *
+ * Errors, eg. two events at the same time, an unknown name, an empty repeat,
+ * or too many entries (or repeat iterations), throw std::runtime_error with a line number.
+ *
+ * Results are cached by a hash of the text and parameters.
+ * So recompiling an unchanged description only copies the result.
+ */
+class epicsShareClass SeqCompiler
+{
+public:
+    explicit SeqCompiler(size_t cacheSize=16);
+    ~SeqCompiler();
+
+    /** @brief Compile, or find in cache
+     *
+     * @param text Description
+     * @param clockHz Sequencer clock frequency, to convert times with units
+     * @param maxEntries Limit on result size, including 0x7f.  Zero for no limit (streaming).
+     * @param out Result.  Unchanged on error.
+     */
+    void compile(const std::string& text, double clockHz, size_t maxEntries, SeqArrays& out);
+
+    //! Compile without cache
+    static void compileOnce(const std::string& text, double clockHz, size_t maxEntries, SeqArrays& out);
+
+    static epicsUInt64 hash(const std::string& text, double clockHz, size_t maxEntries);
+
+    size_t cacheHits() const;
+    size_t cacheMisses() const;
+
+private:
+    struct Entry {
+        std::string text;
+        double clockHz;
+        size_t maxEntries;
+        epicsUInt64 lastUse;
+        SeqArrays result;
+    };
+    typedef std::multimap<epicsUInt64, Entry*> cache_t;
+
+    mutable epicsMutex lock;
+    const size_t cacheSize;
+    cache_t cache;
+    epicsUInt64 useCount;
+    size_t nhits, nmisses;
+
+    SeqCompiler(const SeqCompiler&);
+    SeqCompiler& operator=(const SeqCompiler&);
+};
+
+#endif // SEQCOMPILE_H
@@ -0,0 +1,146 @@
+/*************************************************************************\
+* mrfioc2 is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+#include <stdexcept>
+#include <string.h>
+
+#include <dbDefs.h>
+#include "epicsUnitTest.h"
+#include "testMain.h"
+
+#include "seqcompile.h"
+
+namespace {
+
+const double clockHz = 100e6; // 10 ns per tick
+
+bool compileFails(const char *text, size_t maxEntries=2048u)
+{
+    SeqArrays out;
+    try {
+        SeqCompiler::compileOnce(text, clockHz, maxEntries, out);
+        return false;
+    } catch(std::runtime_error& e) {
+        testDiag("Expected error: %s", e.what());
+        return true;
+    }
+}
+
+void testBasic()
+{
+    testDiag("In testBasic()");
+    SeqArrays out;
+
+    SeqCompiler::compileOnce("# comment\n"
+                             "event INJ = 20\n"
+                             "at 10us INJ mask 1 ena 2\n"
+                             "after 5 21; at 2 22\n",
+                             clockHz, 2048u, out);
+
+    testOk(out.size()==4u, "size %u", unsigned(out.size()));
+    if(out.size()!=4u)
+        return;
+    // sorted by time
+    testOk1(out.times[0]==2u && out.codes[0]==22u);
+    testOk1(out.times[1]==1000u && out.codes[1]==20u);
+    testOk1(out.masks[1]==1u && out.enables[1]==2u);
+    testOk1(out.times[2]==1005u && out.codes[2]==21u);
+    testOk1(out.times[3]==1006u && out.codes[3]==0x7f);
+}
+
+void testRepeat()
+{
+    testDiag("In testRepeat()");
+    SeqArrays out;
+
+    SeqCompiler::compileOnce("at 0 1\n"
+                             "repeat 3 every 100 {\n"
+                             "  after 10 2\n"
+                             "  repeat 2 every 20 {\n"
+                             "    after 5 3\n"
+                             "  }\n"
+                             "}\n"
+                             "end at 1000\n",
+                             clockHz, 2048u, out);
+
+    const epicsUInt64 T[] = {0, 10, 15, 35,
+                             110, 115, 135,
+                             210, 215, 235,
+                             1000};
+    const epicsUInt8 C[] = {1, 2, 3, 3,
+                            2, 3, 3,
+                            2, 3, 3,
+                            0x7f};
+    bool ok = out.size()==NELEMENTS(T);
+    for(size_t i=0; ok && i<NELEMENTS(T); i++)
+        ok &= out.times[i]==T[i] && out.codes[i]==C[i];
+    testOk(ok, "nested repeats");
+    if(!ok) {
+        for(size_t i=0; i<out.size(); i++)
+            testDiag("%u: %u %u", unsigned(i), unsigned(out.times[i]), out.codes[i]);
+    }
+}
+
+void testErrors()
+{
+    testDiag("In testErrors()");
+    testOk1(compileFails("at 0 1\nat 0 2\n"));          // same time
+    testOk1(compileFails("at 0 FOO\n"));                // unknown name
+    testOk1(compileFails("at 0 127\n"));                // 0x7f reserved
+    testOk1(compileFails("at 0 256\n"));                // code range
+    testOk1(compileFails("at 0 1 mask 16\n"));          // mask range
+    testOk1(compileFails("at 1x 1\n"));                 // unit
+    testOk1(compileFails("repeat 2 every 10 { at 0 1\n")); // unclosed
+    testOk1(compileFails("at 10 1\nend at 5\n"));       // end before last
+    testOk1(compileFails("at 0xffffffff 1\n"));         // overflow
+    testOk1(compileFails("repeat 3 every 10 { after 1 1 }\n", 3u)); // RAM limit
+    testOk1(compileFails("repeat 2 every 10 { }\n"));  // empty body
+    testOk1(compileFails("repeat 4294967295 every 1 { repeat 4294967295 every 1 { } }\n", 0u));
+    testOk1(!compileFails("repeat 3 every 10 { after 1 1 }\n", 0u)); // unlimited
+}
+
+void testCache()
+{
+    testDiag("In testCache()");
+    SeqCompiler C(2u);
+    SeqArrays A, B;
+
+    C.compile("at 0 1", clockHz, 2048u, A);
+    C.compile("at 0 1", clockHz, 2048u, B);
+    testOk1(C.cacheMisses()==1u && C.cacheHits()==1u);
+    testOk1(A.times==B.times && A.codes==B.codes);
+
+    C.compile("at 0 1", clockHz/2, 2048u, B); // different parameters
+    testOk1(C.cacheMisses()==2u);
+
+    C.compile("at 0 1", clockHz, 2048u, B); // now most recently used
+    C.compile("at 0 2", clockHz, 2048u, B); // evicts clockHz/2
+    C.compile("at 0 1", clockHz, 2048u, B);
+    testOk1(C.cacheMisses()==3u && C.cacheHits()==3u);
+
+    try {
+        C.compile("at 0 1\nat 0 1", clockHz, 2048u, B);
+        testFail("no error");
+    } catch(std::runtime_error&) {
+        testPass("error not cached");
+    }
+    testOk1(B.size()==2u && B.codes[0]==1u);
+}
+
+} // namespace
+
+MAIN(seqcompileTest)
+{
+    testPlan(26);
+    try {
+        testBasic();
+        testRepeat();
+        testErrors();
+        testCache();
+    } catch(std::exception& e) {
+        testAbort("Unexpected exception: %s", e.what());
+    }
+    return testDone();
+}